@@ -0,0 +1,149 @@
+#include "analysistap.h"
+#include "vectorkernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace nap
+{
+
+	static constexpr float minimumDecibels = -120.f;
+
+
+	AnalysisTap::AnalysisTap()
+	{
+		mRing.assign(ringSize, 0.f);
+		mHistory.assign(fftSize, 0.f);
+		mFFTBuffer.resize(fftSize);
+		mMagnitudes.assign(fftSize / 2, 0.f);
+		mScope.assign(scopeSize, 0.f);
+		mSpectrum.assign(spectrumBinCount, minimumDecibels);
+
+		mWindow.resize(fftSize);
+		for (auto i = 0; i < fftSize; ++i)
+			mWindow[i] = 0.5f - 0.5f * std::cos(2.0 * M_PI * i / (fftSize - 1));
+	}
+
+
+	void AnalysisTap::write(const float* const* channels, int channelCount, int numSamples)
+	{
+		if (channelCount == 0 || numSamples == 0)
+			return;
+
+		float peak = 0.f;
+		float sumOfSquares = 0.f;
+		for (auto channel = 0; channel < channelCount; ++channel)
+			simd::measureLevels(channels[channel], numSamples, peak, sumOfSquares);
+		mPeak.store(peak, std::memory_order_relaxed);
+		mRMS.store(std::sqrt(sumOfSquares / (channelCount * numSamples)), std::memory_order_relaxed);
+
+		// Mono mix into the ring, unless it would overwrite what the reader is yet to collect
+		auto position = mWritePosition.load(std::memory_order_relaxed);
+		if (position + numSamples - mReadPosition.load(std::memory_order_acquire) > ringSize)
+		{
+			mSkippedCount.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		const float gain = 1.f / channelCount;
+		for (auto i = 0; i < numSamples; ++i)
+		{
+			float sum = 0.f;
+			for (auto channel = 0; channel < channelCount; ++channel)
+				sum += channels[channel][i];
+			mRing[(position + i) & (ringSize - 1)] = sum * gain;
+		}
+		mWritePosition.store(position + numSamples, std::memory_order_release);
+	}
+
+
+	void AnalysisTap::update()
+	{
+		auto writePosition = mWritePosition.load(std::memory_order_acquire);
+		auto available = std::min<uint64_t>(writePosition - mReadPosition.load(std::memory_order_relaxed), fftSize);
+		if (available == 0)
+			return;
+
+		std::copy(mHistory.begin() + available, mHistory.end(), mHistory.begin());
+		auto destination = mHistory.end() - available;
+		for (auto position = writePosition - available; position < writePosition; ++position)
+			*destination++ = mRing[position & (ringSize - 1)];
+		mReadPosition.store(writePosition, std::memory_order_release);
+	}
+
+
+	void AnalysisTap::analyse(float sampleRate)
+	{
+		// Scope, the peak of every stretch keeps short transients visible
+		const int stride = fftSize / scopeSize;
+		for (auto i = 0; i < scopeSize; ++i)
+		{
+			float value = 0.f;
+			for (auto j = 0; j < stride; ++j)
+			{
+				float sample = mHistory[i * stride + j];
+				if (std::abs(sample) > std::abs(value))
+					value = sample;
+			}
+			mScope[i] = value;
+		}
+
+		// Spectrum, Hann windowed and scaled so a full scale sine reads 0 dB
+		for (auto i = 0; i < fftSize; ++i)
+			mFFTBuffer[i] = { mHistory[i] * mWindow[i], 0.f };
+		fft(mFFTBuffer);
+		const float scale = 4.f / fftSize;
+		for (auto i = 0; i < fftSize / 2; ++i)
+			mMagnitudes[i] = std::abs(mFFTBuffer[i]) * scale;
+
+		// Resample to a log frequency axis, taking the loudest fft bin in every band
+		const float nyquist = 0.5f * sampleRate;
+		const float lowest = 20.f;
+		const float binWidth = sampleRate / fftSize;
+		for (auto band = 0; band < spectrumBinCount; ++band)
+		{
+			float low = lowest * std::pow(nyquist / lowest, float(band) / spectrumBinCount);
+			float high = lowest * std::pow(nyquist / lowest, float(band + 1) / spectrumBinCount);
+			int first = std::clamp<int>(low / binWidth, 1, fftSize / 2 - 1);
+			int last = std::clamp<int>(high / binWidth, first, fftSize / 2 - 1);
+			float magnitude = 0.f;
+			for (auto bin = first; bin <= last; ++bin)
+				magnitude = std::max(magnitude, mMagnitudes[bin]);
+			mSpectrum[band] = magnitude > 0.f ? std::max(20.f * std::log10(magnitude), minimumDecibels) : minimumDecibels;
+		}
+	}
+
+
+	void AnalysisTap::fft(std::vector<std::complex<float>>& data)
+	{
+		// Iterative radix-2, in place
+		const int size = data.size();
+		for (int i = 1, j = 0; i < size; ++i)
+		{
+			int bit = size >> 1;
+			for (; j & bit; bit >>= 1)
+				j ^= bit;
+			j ^= bit;
+			if (i < j)
+				std::swap(data[i], data[j]);
+		}
+
+		for (auto length = 2; length <= size; length <<= 1)
+		{
+			const double angle = -2.0 * M_PI / length;
+			const std::complex<float> step(std::cos(angle), std::sin(angle));
+			for (auto start = 0; start < size; start += length)
+			{
+				std::complex<float> twiddle(1.f, 0.f);
+				for (auto k = 0; k < length / 2; ++k)
+				{
+					auto even = data[start + k];
+					auto odd = data[start + k + length / 2] * twiddle;
+					data[start + k] = even + odd;
+					data[start + k + length / 2] = even - odd;
+					twiddle *= step;
+				}
+			}
+		}
+	}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+
+namespace nap
+{
+
+	// Taps the plugin output for the editor's meters, scope and spectrum.
+	// The audio thread measures peak and RMS and copies a mono mix into a ring, it never waits and never allocates.
+	// The control thread drains the ring and does the heavier analysis, only when something is drawn.
+	// A block that would overwrite samples the reader hasn't collected yet is left out of the ring, the levels are still measured.
+	class AnalysisTap
+	{
+	public:
+		static constexpr int ringSize = 1 << 15;
+		static constexpr int fftSize = 2048;
+		static constexpr int scopeSize = 512;
+		static constexpr int spectrumBinCount = 128;
+
+		AnalysisTap();
+
+		// Audio thread, measures the block and hands it to the control thread
+		void write(const float* const* channels, int channelCount, int numSamples);
+
+		// Levels of the last written block, linear amplitude
+		float getPeak() const { return mPeak.load(std::memory_order_relaxed); }
+		float getRMS() const { return mRMS.load(std::memory_order_relaxed); }
+
+		// Control thread, collects what was written since the last call
+		void update();
+
+		// Blocks left out of the ring because the reader was behind
+		uint64_t getSkippedCount() const { return mSkippedCount.load(std::memory_order_relaxed); }
+
+		// Control thread, refreshes the scope and the spectrum from the collected samples
+		void analyse(float sampleRate);
+		const std::vector<float>& getScope() const { return mScope; }
+		const std::vector<float>& getSpectrum() const { return mSpectrum; }	// Decibels on a log frequency axis from 20 Hz to Nyquist
+
+	private:
+		static void fft(std::vector<std::complex<float>>& data);
+
+		// Shared
+		std::vector<float> mRing;
+		std::atomic<uint64_t> mWritePosition = { 0 };
+		std::atomic<uint64_t> mReadPosition = { 0 };
+		std::atomic<uint64_t> mSkippedCount = { 0 };
+		std::atomic<float> mPeak = { 0.f };
+		std::atomic<float> mRMS = { 0.f };
+
+		// Control thread
+		std::vector<float> mHistory;		// The last fftSize samples, oldest first
+		std::vector<float> mWindow;
+		std::vector<std::complex<float>> mFFTBuffer;
+		std::vector<float> mMagnitudes;
+		std::vector<float> mScope;
+		std::vector<float> mSpectrum;
+	};
+
+}
@@ -0,0 +1,103 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+namespace nap
+{
+
+	void* Arena::allocate(size_t size)
+	{
+		size = (size + alignment - 1) & ~(alignment - 1);
+		if (mChunks.empty() || mPosition + size > mChunks.back().mSize)
+			if (!addChunk(size))
+				throw std::bad_alloc();
+
+		void* memory = mChunks.back().mMemory + mPosition;
+		mPosition += size;
+		mUsedSize += size;
+		return memory;
+	}
+
+
+	void Arena::release()
+	{
+		if (mUsedSize > 0)
+			mExpectedSize = mUsedSize;
+
+		for (auto& chunk : mChunks)
+		{
+#ifndef _WIN32
+			if (chunk.mMapped)
+			{
+				munmap(chunk.mMemory, chunk.mSize);
+				continue;
+			}
+#endif
+			::operator delete(chunk.mMemory, std::align_val_t(alignment));
+		}
+		mChunks.clear();
+		mPosition = 0;
+		mUsedSize = 0;
+		mReservedSize = 0;
+		mHugePageChunkCount = 0;
+	}
+
+
+	bool Arena::addChunk(size_t minimumSize)
+	{
+		// The first chunk of a round takes what the previous round used, later ones double the reservation
+		Chunk chunk;
+		auto size = std::max({ minimumSize, mChunks.empty() ? mExpectedSize : mReservedSize, minimumChunkSize });
+		const bool huge = size >= hugePageSize;
+		const size_t granularity = huge ? hugePageSize : pageSize;
+		chunk.mSize = (size + granularity - 1) / granularity * granularity;
+
+#ifndef _WIN32
+		// Explicit huge pages first, they only exist when the system has reserved some.
+		// Otherwise ask for transparent huge pages, which Linux may or may not grant later on.
+		void* memory = MAP_FAILED;
+#ifdef MAP_HUGETLB
+		if (huge)
+		{
+			memory = mmap(nullptr, chunk.mSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (memory != MAP_FAILED)
+				mHugePageChunkCount++;
+		}
+#endif
+		if (memory == MAP_FAILED)
+		{
+			memory = mmap(nullptr, chunk.mSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+			if (memory != MAP_FAILED && huge)
+				madvise(memory, chunk.mSize, MADV_HUGEPAGE);
+#endif
+		}
+		if (memory != MAP_FAILED)
+		{
+			// Anonymous mappings are zeroed already
+			chunk.mMemory = static_cast<char*>(memory);
+			chunk.mMapped = true;
+		}
+#endif
+
+		if (chunk.mMemory == nullptr)
+		{
+			chunk.mMemory = static_cast<char*>(::operator new(chunk.mSize, std::align_val_t(alignment), std::nothrow));
+			if (chunk.mMemory == nullptr)
+				return false;
+			std::memset(chunk.mMemory, 0, chunk.mSize);
+		}
+
+		mChunks.emplace_back(chunk);
+		mPosition = 0;
+		mReservedSize += chunk.mSize;
+		return true;
+	}
+
+}
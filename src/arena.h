@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+
+namespace nap
+{
+
+	// Bump allocator for the buffers of one plugin instance.
+	// Chunks are sized to what the previous round of allocations used, so after the first activation everything
+	// fits one chunk of just the right size. Only chunks of 2 MB and up ask for huge pages, a huge page
+	// under a smaller chunk would make most of it resident for nothing.
+	// Memory is only handed back as a whole in release(). Allocations are cache line aligned and zeroed.
+	// Not thread safe, allocate while the audio thread is not running.
+	class Arena
+	{
+	public:
+		static constexpr size_t alignment = 64;
+		static constexpr size_t pageSize = 4096;
+		static constexpr size_t hugePageSize = 2 * 1024 * 1024;		// On x86_64 and arm64 Linux
+		static constexpr size_t minimumChunkSize = 64 * 1024;
+
+		Arena() = default;
+		~Arena() { release(); }
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		void* allocate(size_t size);
+		float* allocateFloats(size_t count) { return static_cast<float*>(allocate(count * sizeof(float))); }
+
+		// Frees all chunks, every pointer handed out becomes invalid.
+		// The amount used so far sizes the first chunk of the next round.
+		void release();
+
+		size_t getUsedSize() const { return mUsedSize; }
+		size_t getReservedSize() const { return mReservedSize; }
+		int getChunkCount() const { return mChunks.size(); }
+		int getHugePageChunkCount() const { return mHugePageChunkCount; }
+
+	private:
+		struct Chunk
+		{
+			char* mMemory = nullptr;
+			size_t mSize = 0;
+			bool mMapped = false;
+		};
+
+		bool addChunk(size_t minimumSize);
+
+		std::vector<Chunk> mChunks;
+		size_t mPosition = 0;			// In the last chunk
+		size_t mUsedSize = 0;
+		size_t mReservedSize = 0;
+		size_t mExpectedSize = 0;		// Used size of the previous round
+		int mHugePageChunkCount = 0;
+	};
+
+}
@@ -0,0 +1,188 @@
+#include "audioworker.h"
+
+#include <algorithm>
+
+#if defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#else
+#include <semaphore.h>
+#endif
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+namespace nap
+{
+
+	// Signalling never blocks or allocates, so the audio thread can wake the worker
+	class AudioWorker::Semaphore
+	{
+	public:
+#if defined(__APPLE__)
+		Semaphore() : mSemaphore(dispatch_semaphore_create(0)) { }
+		~Semaphore() { dispatch_release(mSemaphore); }
+		void signal() { dispatch_semaphore_signal(mSemaphore); }
+		void wait() { dispatch_semaphore_wait(mSemaphore, DISPATCH_TIME_FOREVER); }
+	private:
+		dispatch_semaphore_t mSemaphore;
+#elif defined(_WIN32)
+		Semaphore() : mSemaphore(CreateSemaphore(nullptr, 0, LONG_MAX, nullptr)) { }
+		~Semaphore() { CloseHandle(mSemaphore); }
+		void signal() { ReleaseSemaphore(mSemaphore, 1, nullptr); }
+		void wait() { WaitForSingleObject(mSemaphore, INFINITE); }
+	private:
+		HANDLE mSemaphore;
+#else
+		Semaphore() { sem_init(&mSemaphore, 0, 0); }
+		~Semaphore() { sem_destroy(&mSemaphore); }
+		void signal() { sem_post(&mSemaphore); }
+		void wait() { while (sem_wait(&mSemaphore) != 0) { } }
+	private:
+		sem_t mSemaphore;
+#endif
+	};
+
+
+	AudioWorker::AudioWorker(RenderFunction renderFunction) :
+		mRenderFunction(std::move(renderFunction)), mWakeUp(std::make_unique<Semaphore>())
+	{
+	}
+
+
+	AudioWorker::~AudioWorker()
+	{
+		stop();
+	}
+
+
+	void AudioWorker::start(int inputChannelCount, int outputChannelCount, int maxBlockSize, Arena& arena)
+	{
+		stop();
+
+		mMaxBlockSize = maxBlockSize;
+		mJobInputs.resize(inputChannelCount);
+		for (auto& channel : mJobInputs)
+			channel = arena.allocateFloats(maxBlockSize);
+		mJobOutputs.resize(outputChannelCount);
+		for (auto& channel : mJobOutputs)
+			channel = arena.allocateFloats(maxBlockSize);
+
+		// The fifo starts out holding one block of silence: that is the latency reported to the host
+		mFifo.resize(outputChannelCount);
+		for (auto& channel : mFifo)
+			channel = arena.allocateFloats(2 * maxBlockSize);
+		mFifoReadPosition = 0;
+		mFifoWritePosition = maxBlockSize;
+
+		mJobPending.store(false);
+		mStopping.store(false);
+		mDropoutCount.store(0);
+		mJobSize = 0;
+		mOutstandingSize = 0;
+		mThread = std::thread([&](){ run(); });
+
+#ifndef _WIN32
+		// Best effort, fails silently when the host process is not allowed to schedule real-time threads
+		sched_param param;
+		param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
+		pthread_setschedparam(mThread.native_handle(), SCHED_FIFO, &param);
+#endif
+	}
+
+
+	void AudioWorker::stop()
+	{
+		if (!mThread.joinable())
+			return;
+		mStopping.store(true);
+		mWakeUp->signal();
+		mThread.join();
+
+		// The buffers belong to the arena
+		mJobInputs.clear();
+		mJobOutputs.clear();
+		mFifo.clear();
+	}
+
+
+	void AudioWorker::process(float** inputs, float** outputs, int numSamples)
+	{
+		// Fifo level plus outstanding samples stays at maxBlockSize, so the fifo never runs dry
+		if (mJobPending.load(std::memory_order_acquire))
+		{
+			// Missed deadline: the late block and the current one become silence, the late output is dropped when it arrives
+			mDropoutCount.fetch_add(1, std::memory_order_relaxed);
+			writeFifo(nullptr, mOutstandingSize + numSamples);
+			mOutstandingSize = 0;
+		}
+		else
+		{
+			writeFifo(mJobOutputs.data(), mOutstandingSize);
+
+			// Hand over the current block
+			for (auto channel = 0; channel < mJobInputs.size(); ++channel)
+			{
+				if (inputs != nullptr)
+					std::copy(inputs[channel], inputs[channel] + numSamples, mJobInputs[channel]);
+				else
+					std::fill(mJobInputs[channel], mJobInputs[channel] + numSamples, 0.f);
+			}
+			mJobSize = numSamples;
+			mOutstandingSize = numSamples;
+			mJobPending.store(true, std::memory_order_release);
+			mWakeUp->signal();
+		}
+
+		const int fifoSize = 2 * mMaxBlockSize;
+		for (auto channel = 0; channel < mFifo.size(); ++channel)
+		{
+			const float* fifo = mFifo[channel];
+			auto position = mFifoReadPosition;
+			for (auto i = 0; i < numSamples; ++i)
+			{
+				outputs[channel][i] = fifo[position];
+				if (++position == fifoSize)
+					position = 0;
+			}
+		}
+		mFifoReadPosition = (mFifoReadPosition + numSamples) % fifoSize;
+	}
+
+
+	void AudioWorker::writeFifo(float** source, int numSamples)
+	{
+		const int fifoSize = 2 * mMaxBlockSize;
+		for (auto channel = 0; channel < mFifo.size(); ++channel)
+		{
+			float* fifo = mFifo[channel];
+			auto position = mFifoWritePosition;
+			for (auto i = 0; i < numSamples; ++i)
+			{
+				fifo[position] = source != nullptr ? source[channel][i] : 0.f;
+				if (++position == fifoSize)
+					position = 0;
+			}
+		}
+		mFifoWritePosition = (mFifoWritePosition + numSamples) % fifoSize;
+	}
+
+
+	void AudioWorker::run()
+	{
+		while (true)
+		{
+			mWakeUp->wait();
+			if (mStopping.load())
+				return;
+			if (!mJobPending.load(std::memory_order_acquire))
+				continue;
+
+			mRenderFunction(mJobInputs.data(), mJobOutputs.data(), mJobSize);
+			mJobPending.store(false, std::memory_order_release);
+		}
+	}
+
+}
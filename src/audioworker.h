@@ -0,0 +1,67 @@
+#pragma once
+
+#include "arena.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+namespace nap
+{
+
+	// Runs an audio render function on a dedicated thread, one block behind the caller.
+	// Every process() call hands its input to the worker and returns output rendered during the previous call.
+	// Output is passed through a fifo primed with maxBlockSize samples of silence,
+	// so the added latency is constant no matter how the host varies its block size.
+	// The audio thread never waits: a block the worker has not finished in time is replaced by silence and counted as a dropout.
+	class AudioWorker
+	{
+	public:
+		using RenderFunction = std::function<void(float** inputs, float** outputs, int numSamples)>;
+
+		AudioWorker(RenderFunction renderFunction);
+		~AudioWorker();
+
+		// Buffers are taken from the arena, which has to outlive the next stop()
+		void start(int inputChannelCount, int outputChannelCount, int maxBlockSize, Arena& arena);
+		void stop();
+		bool isRunning() const { return mThread.joinable(); }
+
+		// Added delay in samples while running.
+		int getLatencySamples() const { return mMaxBlockSize; }
+
+		// Called from the audio thread, numSamples may not exceed the maxBlockSize passed to start().
+		void process(float** inputs, float** outputs, int numSamples);
+
+		// Blocks replaced by silence because the worker missed its deadline, since the last start()
+		uint64_t getDropoutCount() const { return mDropoutCount.load(std::memory_order_relaxed); }
+
+	private:
+		class Semaphore;
+
+		void run();
+		void writeFifo(float** source, int numSamples);
+
+		RenderFunction mRenderFunction;
+		std::thread mThread;
+		std::unique_ptr<Semaphore> mWakeUp;
+		std::atomic<bool> mJobPending = { false };		// Set by the audio thread, cleared by the worker when the job's output is ready
+		std::atomic<bool> mStopping = { false };
+		std::atomic<uint64_t> mDropoutCount = { 0 };
+		int mJobSize = 0;
+		int mOutstandingSize = 0;		// Samples handed over whose output has not been written to the fifo yet
+		int mMaxBlockSize = 0;
+
+		std::vector<float*> mJobInputs;
+		std::vector<float*> mJobOutputs;
+
+		std::vector<float*> mFifo;
+		int mFifoReadPosition = 0;
+		int mFifoWritePosition = 0;
+	};
+
+}
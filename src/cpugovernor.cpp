@@ -0,0 +1,97 @@
+#include "cpugovernor.h"
+
+#include <algorithm>
+
+namespace nap
+{
+
+	static constexpr float smoothing = 0.1f;
+	static constexpr float overloadThreshold = 0.85f;
+	static constexpr float headroomThreshold = 0.5f;
+	static constexpr int overloadBlockCount = 16;		// Shed quality quickly
+	static constexpr int headroomBlockCount = 1024;		// Restore it slowly, to avoid flip-flopping
+
+
+	void CPUGovernor::addMeasurement(double processTime, double budget)
+	{
+		float load = budget > 0.0 ? float(processTime / budget) : 0.f;
+		mSmoothedLoad += smoothing * (load - mSmoothedLoad);
+		mLoad.store(mSmoothedLoad);
+
+		auto level = mLevel.load();
+		if (mSmoothedLoad > overloadThreshold)
+		{
+			mHeadroomBlocks = 0;
+			if (++mOverloadBlocks >= overloadBlockCount && level != ELevel::Minimal)
+				setLevel(ELevel(int(level) + 1));
+		}
+		else if (mSmoothedLoad < headroomThreshold)
+		{
+			mOverloadBlocks = 0;
+			if (++mHeadroomBlocks >= headroomBlockCount && level != ELevel::Full)
+				setLevel(ELevel(int(level) - 1));
+		}
+		else
+		{
+			mOverloadBlocks = 0;
+			mHeadroomBlocks = 0;
+		}
+	}
+
+
+	void CPUGovernor::reset()
+	{
+		mSmoothedLoad = 0.f;
+		mOverloadBlocks = 0;
+		mHeadroomBlocks = 0;
+		mLoad.store(0.f);
+		mLevel.store(ELevel::Full);
+	}
+
+
+	const char* CPUGovernor::getLevelName(ELevel level)
+	{
+		switch (level)
+		{
+			case ELevel::Full:
+				return "Full";
+			case ELevel::ReducedGUI:
+				return "Reduced GUI";
+			case ELevel::ReducedOversampling:
+				return "Reduced oversampling";
+			case ELevel::Minimal:
+				return "Minimal";
+		}
+		return "";
+	}
+
+
+	int CPUGovernor::getOversamplingLimit(ELevel level, int factor)
+	{
+		if (level == ELevel::Minimal)
+			return 1;
+		if (level == ELevel::ReducedOversampling)
+			return std::max(factor / 2, 1);
+		return factor;
+	}
+
+
+	int CPUGovernor::getVoiceLimit(ELevel level, int voiceCount)
+	{
+		if (level == ELevel::Minimal)
+			return std::max(voiceCount / 2, 1);
+		if (level == ELevel::ReducedOversampling)
+			return std::max(voiceCount * 3 / 4, 1);
+		return voiceCount;
+	}
+
+
+	void CPUGovernor::setLevel(ELevel level)
+	{
+		mLevel.store(level);
+		mLevelChangeCount.fetch_add(1);
+		mOverloadBlocks = 0;
+		mHeadroomBlocks = 0;
+	}
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+
+namespace nap
+{
+
+	// Tracks how much of the real-time budget process() uses and decides how much quality to shed.
+	// Sustained overload raises the level one step at a time, a long stretch of headroom lowers it again.
+	class CPUGovernor
+	{
+	public:
+		enum class ELevel : int
+		{
+			Full = 0,				// Everything enabled
+			ReducedGUI,				// Editor renders at a quarter of the frame rate
+			ReducedOversampling,	// Realtime oversampling halved, three quarters of the voices
+			Minimal					// No oversampling, half the voices and no editor rendering
+		};
+
+		// Called from the audio thread after every block
+		void addMeasurement(double processTime, double budget);
+
+		// Back to full quality, for instance when switching to offline rendering
+		void reset();
+
+		ELevel getLevel() const { return mLevel.load(); }
+		float getLoad() const { return mLoad.load(); }
+		uint64_t getLevelChangeCount() const { return mLevelChangeCount.load(); }
+
+		static const char* getLevelName(ELevel level);
+
+		// What a level leaves of the realtime oversampling factor and of the synth's voices
+		static int getOversamplingLimit(ELevel level, int factor);
+		static int getVoiceLimit(ELevel level, int voiceCount);
+
+	private:
+		void setLevel(ELevel level);
+
+		float mSmoothedLoad = 0.f;
+		int mOverloadBlocks = 0;
+		int mHeadroomBlocks = 0;
+
+		std::atomic<ELevel> mLevel = { ELevel::Full };
+		std::atomic<float> mLoad = { 0.f };
+		std::atomic<uint64_t> mLevelChangeCount = { 0 };
+	};
+
+}
@@ -0,0 +1,100 @@
+#include "midirouter.h"
+
+#include <algorithm>
+
+
+namespace nap
+{
+
+	MidiRouter::MidiRouter()
+	{
+		// Nothing listens until the first build()
+		Table table;
+		table.fill(0);
+		mTable.init(table);
+	}
+
+
+	int MidiRouter::getBit(EType type, int channel, int number)
+	{
+		return (int(type) * channelCount + channel) * numberCount + number;
+	}
+
+
+	void MidiRouter::build(const std::vector<Filter>& filters)
+	{
+		// Mirrors the checks the component instances do on every event
+		auto& table = mTable.getWriteBuffer();
+		table.fill(0);
+		for (auto& filter : filters)
+		{
+			if (!filter.mPorts.empty() && std::find(filter.mPorts.begin(), filter.mPorts.end(), "") == filter.mPorts.end())
+				continue;
+
+			for (auto type = 0; type < int(EType::Count); ++type)
+			{
+				if (!filter.mTypes[type])
+					continue;
+				for (auto channel = 0; channel < channelCount; ++channel)
+				{
+					if (!filter.mChannels.empty() && std::find(filter.mChannels.begin(), filter.mChannels.end(), channel) == filter.mChannels.end())
+						continue;
+					for (auto number = 0; number < numberCount; ++number)
+					{
+						if (!filter.mNumbers.empty() && std::find(filter.mNumbers.begin(), filter.mNumbers.end(), number) == filter.mNumbers.end())
+							continue;
+						int bit = getBit(EType(type), channel, number);
+						table[bit / 64] |= uint64_t(1) << (bit % 64);
+					}
+				}
+			}
+		}
+		mTable.publish();
+	}
+
+
+	bool MidiRouter::push(EType type, int channel, int number, int value)
+	{
+		mTable.update();
+		if (type < EType::NoteOff || type >= EType::Count)
+			return false;
+		int bit = getBit(type, channel & (channelCount - 1), number & (numberCount - 1));
+		if ((mTable.getReadBuffer()[bit / 64] & (uint64_t(1) << (bit % 64))) == 0)
+		{
+			mFilteredCount.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		// Controllers stop short of the reserve, note ons of its last half
+		uint32_t room = queueSize;
+		if (type == EType::NoteOn)
+			room -= noteReserve / 2;
+		else if (type != EType::NoteOff)
+			room -= noteReserve;
+		auto writePosition = mWritePosition.load(std::memory_order_relaxed);
+		if (writePosition - mReadPosition.load(std::memory_order_acquire) >= room)
+		{
+			mDroppedCount.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		mQueue[writePosition & (queueSize - 1)] = { type, uint8_t(channel & (channelCount - 1)), uint8_t(number & 0x7f), uint8_t(value & 0x7f) };
+		mWritePosition.store(writePosition + 1, std::memory_order_release);
+		return true;
+	}
+
+
+	int MidiRouter::dispatch(const DispatchFunction& dispatch)
+	{
+		auto readPosition = mReadPosition.load(std::memory_order_relaxed);
+		auto writePosition = mWritePosition.load(std::memory_order_acquire);
+		for (auto position = readPosition; position != writePosition; ++position)
+		{
+			auto& event = mQueue[position & (queueSize - 1)];
+			dispatch(event.mType, event.mChannel, event.mNumber, event.mValue);
+		}
+		mReadPosition.store(writePosition, std::memory_order_release);
+		return writePosition - readPosition;
+	}
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "triplebuffer.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+namespace nap
+{
+
+	// Takes MIDI from the audio thread to the control thread without allocating on the audio thread.
+	// A flat table, built from the filters of every MIDI input component, tells per type, channel and number
+	// whether any component listens. Everything else is discarded right away.
+	// Accepted events travel as plain values through a single producer, single consumer ring.
+	// Part of the ring is kept for note events, so a burst of controllers can't crowd out a note off.
+	class MidiRouter
+	{
+	public:
+		static constexpr int channelCount = 16;
+		static constexpr int numberCount = 128;
+		static constexpr int queueSize = 4096;		// Power of two
+		static constexpr int noteReserve = 512;		// Slots only note events can use, the last half of them only note offs
+
+		enum class EType : int
+		{
+			NoteOff = 0,
+			NoteOn,
+			Aftertouch,
+			ControlChange,
+			ProgramChange,
+			ChannelPressure,
+			PitchBend,
+			Count
+		};
+
+		// What one component listens to, empty lists match everything
+		struct Filter
+		{
+			std::array<bool, int(EType::Count)> mTypes;
+			std::vector<int> mChannels;
+			std::vector<int> mNumbers;
+			std::vector<std::string> mPorts;
+		};
+
+		using DispatchFunction = std::function<void(EType type, int channel, int number, int value)>;
+
+		MidiRouter();
+
+		// Control thread, after (re)loading resources. Components without port filter, or listening to the
+		// default port, are subscribed: that's the port events from the host arrive on.
+		void build(const std::vector<Filter>& filters);
+
+		// Audio thread. False when nothing listens or the queue has no room for this type.
+		bool push(EType type, int channel, int number, int value);
+
+		// Control thread, hands everything pushed so far to dispatch in order and returns the event count
+		int dispatch(const DispatchFunction& dispatch);
+
+		uint64_t getFilteredCount() const { return mFilteredCount.load(std::memory_order_relaxed); }
+		uint64_t getDroppedCount() const { return mDroppedCount.load(std::memory_order_relaxed); }
+
+	private:
+		// One bit per channel message type, channel and number
+		using Table = std::array<uint64_t, int(EType::Count) * channelCount * numberCount / 64>;
+		static int getBit(EType type, int channel, int number);
+
+		struct Event
+		{
+			EType mType;
+			uint8_t mChannel;
+			uint8_t mNumber;
+			uint8_t mValue;
+		};
+
+		TripleBuffer<Table> mTable;
+		std::array<Event, queueSize> mQueue;
+		std::atomic<uint32_t> mWritePosition = { 0 };
+		std::atomic<uint32_t> mReadPosition = { 0 };
+		std::atomic<uint64_t> mFilteredCount = { 0 };
+		std::atomic<uint64_t> mDroppedCount = { 0 };
+	};
+
+}
@@ -1,33 +1,48 @@
 #include "napplugin.h"
+#include "parameterstate.h"
+#include "pluginstate.h"
+#include "vectorkernels.h"
 #include "version.h"
 
 #include "public.sdk/source/main/pluginfactory.h"
 #include "public.sdk/source/vst/vstaudioprocessoralgo.h"
 #include "public.sdk/source/vst/utility/stringconvert.h"
 
+#ifdef NAPVST_WITH_EDITOR
 #include "vstgui/lib/vstguiinit.h"
 #include "public.sdk/source/main/moduleinit.h"
+#endif
 
 #include "pluginterfaces/base/funknownimpl.h"
-#include "base/source/fstreamer.h"
 
+#include <audio/component/outputcomponent.h>
+#include <midievent.h>
+#include <midiinputcomponent.h>
 #include <parameternumeric.h>
 #include <parameterdropdown.h>
 #include <parametergroup.h>
 #include <sdlhelpers.h>
 #include <utility/fileutils.h>
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
 #include <functional>
+#include <thread>
+#include <unordered_map>
 
 #include <dlfcn.h>
+#include <SDL3/SDL_hints.h>
 
 constexpr const char* app_json = "app.json";
 
+#ifdef NAPVST_WITH_EDITOR
 using Steinberg::ModuleInitializer;
 using Steinberg::ModuleTerminator;
 using Steinberg::getPlatformModuleHandle;
+#endif
 
 namespace Steinberg
 {
@@ -37,6 +52,8 @@ namespace Steinberg
 
 		NapPlugin::NapPlugin ()
 		{
+			mControllerPoints.reserve(maxControllerPoints);
+			mControllerQueues.reserve(mControllerValues.size());
 		}
 
 
@@ -46,14 +63,30 @@ namespace Steinberg
 			if (result != kResultOk)
 				return result;
 
-			// we want a stereo Input and a Stereo Output
-			addAudioInput  (STR16 ("Stereo In"),  SpeakerArr::kStereo);
-			addAudioOutput (STR16 ("Stereo Out"), SpeakerArr::kStereo);
+			// Stereo by default, see setBusArrangements for the other layouts. Stems are off until the host enables them,
+			// objects.json routes the dry synth to them.
+			addAudioInput  (STR16 ("Main In"),  SpeakerArr::kStereo);
+			addAudioOutput (STR16 ("Main Out"), SpeakerArr::kStereo);
+			addAudioOutput (STR16 ("Stems"), SpeakerArr::kStereo, kAux, 0);
 
 			// One single channel event bus
 			addEventInput (STR16 ("Event In"), 1);
 
 			parameters.addParameter (STR16("Bypass"), nullptr, 1, 0, ParameterInfo::kCanAutomate | ParameterInfo::kIsBypass, kBypassId);
+			parameters.addParameter (STR16("Output Peak"), nullptr, 0, 0, ParameterInfo::kIsReadOnly, kOutputPeakId);
+			parameters.addParameter (STR16("Output RMS"), nullptr, 0, 0, ParameterInfo::kIsReadOnly, kOutputRMSId);
+
+			// Hosts translate MIDI controllers into changes of these, see getMidiControllerAssignment
+			for (auto channel = 0; channel < nap::MidiRouter::channelCount; ++channel)
+			{
+				for (auto controller = 0; controller < midiControllerCount; ++controller)
+				{
+					std::string name = controller == kPitchBend ? "Pitch Bend" : controller == kAfterTouch ? "Channel Pressure" : "CC " + std::to_string(controller);
+					Vst::TChar controllerName[128];
+					Steinberg::Vst::StringConvert::convert("MIDI " + std::to_string(channel + 1) + " " + name, controllerName);
+					parameters.addParameter (controllerName, nullptr, 0, controller == kPitchBend ? 0.5 : 0, ParameterInfo::kIsHidden, kMidiControllerId + channel * midiControllerCount + controller);
+				}
+			}
 
 			nap::utility::ErrorState error;
 
@@ -65,6 +98,7 @@ namespace Steinberg
 				napResult = initializeNAP(mMainThreadQueue, error);
 				napInitialized = true;
 			});
+
 			while (!napInitialized)
 				mMainThreadQueue.process();
 			mMainThreadQueue.process(); // Make sure the queue is empty
@@ -72,10 +106,30 @@ namespace Steinberg
 			if (!napResult)
 				return kResultFalse;
 
+			// One feedback slot per parameter, more are added when a reload adds parameters
+			mParameterFeedback.init(mParameters.size(), getMaxParameterCount());
+			mProcessFeedback.init(mParameters.size(), getMaxParameterCount());
+			mHostEditing.assign(mParameters.size(), false);
+
+			mTelemetry.open();
+			if (!mTelemetry.getPath().empty())
+				nap::Logger::info("Writing telemetry to: %s", mTelemetry.getPath().c_str());
+
 			mEventConverter = std::make_unique<nap::SDLEventConverter>(*mSDLInputService);
-			mTimer = Timer::create(this, 1000.f / 60.f);
+#if SMTG_OS_LINUX
+			// Hosts on Linux hand out their run loop through the host context
+			mRunLoop = FUnknownPtr<Linux::IRunLoop>(context);
+#endif
+			mHostTimer = startMainThreadTimer();
+			if (!mHostTimer)
+				nap::Logger::info("No host timer available, main thread tasks run when the host calls in");
+
+			createOffscreenEditor();
 
+			// Parked again right away, until the host activates the plugin or opens the editor
 			mControlThread.connectPeriodicTask(mControlSlot);
+			mSuspended = false;
+			updateSuspension();
 
 			return result;
 		}
@@ -83,21 +137,42 @@ namespace Steinberg
 
 		bool NapPlugin::initializeNAP(nap::TaskQueue& mainThreadQueue, nap::utility::ErrorState& errorState)
 		{
+			// Time spent per startup phase, logged once everything is up
+			std::string phaseTimes;
+			auto phaseStart = std::chrono::steady_clock::now();
+			auto endPhase = [&](const char* phase)
+			{
+				auto now = std::chrono::steady_clock::now();
+				char entry[64];
+				std::snprintf(entry, sizeof(entry), "%s%s %.1f ms", phaseTimes.empty() ? "" : ", ", phase, std::chrono::duration<double, std::milli>(now - phaseStart).count());
+				phaseTimes += entry;
+				phaseStart = now;
+			};
+
 			mCore = std::make_unique<nap::Core>(mainThreadQueue);
 
-#ifdef __APPLE__
+#if defined(__APPLE__) || defined(__linux__)
+			// The binary lives in Contents/MacOS or Contents/<arch>-linux of the bundle, data in Contents/Resources
 			Dl_info info;
-			dladdr((void*)(app_json), &info);
+			if (!errorState.check(dladdr((void*)(app_json), &info) != 0 && info.dli_fname != nullptr, "Unable to locate the plugin binary"))
+				return false;
 			std::string loaderPath = info.dli_fname;
 			std::string loaderDir = nap::utility::getFileDir(loaderPath);
 			std::string resourcedDir = nap::utility::joinPath({ loaderDir, "..", "Resources" });
 #else
-			std::runtime_error("Not implemented for Windows yet");
+			errorState.fail("Resource lookup not implemented for Windows yet");
+			return false;
 #endif
 
 			if (!mCore->initializeEngineWithoutProjectInfo(errorState))
 				return false;
 			mCore->setupPlatformSpecificEnvironment();
+			endPhase("engine");
+
+#ifndef NAPVST_WITH_EDITOR
+			// Nothing is ever shown, don't depend on a display server. The environment still takes precedence.
+			SDL_SetHintWithPriority(SDL_HINT_VIDEO_DRIVER, "offscreen", SDL_HINT_DEFAULT);
+#endif
 
 			mServices = mCore->initializeServices(errorState);
 			if (mServices == nullptr || !mServices->initialized())
@@ -105,10 +180,12 @@ namespace Steinberg
 				nap::Logger::error(errorState.toString().c_str());
 				return false;
 			}
+			endPhase("services");
 
 			mAudioService = mCore->getService<nap::audio::AudioService>();
+			// Default bus layout, main stereo out followed by the stereo stems. Updated on activation.
 			mAudioService->getNodeManager().setInputChannelCount(2);
-			mAudioService->getNodeManager().setOutputChannelCount(2);
+			mAudioService->getNodeManager().setOutputChannelCount(4);
 
 			std::string data_dir = nap::utility::joinPath({ resourcedDir, "data" });;
 			std::string app_structure_path = nap::utility::joinPath({ data_dir, "objects.json" });
@@ -125,7 +202,8 @@ namespace Steinberg
 					nap::Logger::error("Failed to load app structure: %s", errorState.toString().c_str());
 					return false;
 				}
-				// mCore->getResourceManager()->watchDirectory(data_dir);
+				mCore->getResourceManager()->watchDirectory(data_dir);
+				endPhase("resources");
 			}
 			else {
 				// std::string app_structure = symbol(APP_STRUCTURE_BINARY);
@@ -142,15 +220,32 @@ namespace Steinberg
 			mInputService = mCore->getService<nap::InputService>();
 			mSDLInputService = mCore->getService<nap::SDLInputService>();
 			mGuiService = mCore->getService<nap::IMGuiService>();
+			mMidiRouter.build(getMidiFilters());
 
 			auto parameterGroup = mCore->getResourceManager()->findObject<nap::ParameterGroup>("Parameters").get();
-			if (parameterGroup != nullptr)
-				registerParameters(parameterGroup->mMembers);
+			if (parameterGroup != nullptr && !registerParameters(parameterGroup->mMembers, errorState))
+				return false;
+			syncKnownValues();
+
+			configureVoicePool();
+			endPhase("parameters");
+
+			// Presets in the bundle are a read only factory bank, the user's own go to their presets directory
+			mPresetBank.load(nap::utility::joinPath({ data_dir, "presets" }), nap::PresetBank::getUserDirectory(stringCompanyName, stringPluginName), mParameters);
+			mStagedPresetValues.init(std::vector<float>(mParameters.size(), 0.f));
+			registerPresets();
+			endPhase("presets");
 
 			mParameterGUI = std::make_unique<nap::ParameterGUI>(*mCore);
 			mParameterGUI->mParameterGroup = parameterGroup;
 			if (!mParameterGUI->init(errorState))
 				return false;
+			endPhase("gui");
+			nap::Logger::info("Startup: %s", phaseTimes.c_str());
+
+			// Edits to objects.json are picked up in Core::update on the control thread
+			mCore->getResourceManager()->mPreResourcesLoadedSignal.connect(mResourcesReloadingSlot);
+			mCore->getResourceManager()->mPostResourcesLoadedSignal.connect(mResourcesReloadedSlot);
 
 			mInitialized = true;
 
@@ -164,15 +259,22 @@ namespace Steinberg
 				return kResultOk;
 			mInitialized = false;
 
-			mTimer->stop();
-			mTimer->release();
+			mAudioWorker.stop();
+			stopMainThreadTimer();
+			processMainThread();
 
-			mControlThread.disconnectPeriodicTask(mControlSlot);
+			if (!mSuspended)
+				mControlThread.disconnectPeriodicTask(mControlSlot);
 			nap::Logger::info("disconnected periodic task");
 
 			std::atomic<bool> napTerminated(false);
 			mControlThread.enqueue([&]()
 			{
+				if (mOffscreenRenderWindow != nullptr)
+				{
+					mOffscreenRenderWindow->onDestroy();
+					mOffscreenRenderWindow = nullptr;
+				}
 				mParameterGUI->onDestroy();
 				mParameterGUI = nullptr;
 				mServices = nullptr;
@@ -181,9 +283,21 @@ namespace Steinberg
 			});
 			while (!napTerminated)
 				mMainThreadQueue.process();
+
+			if (mOffscreenWindow != nullptr)
+			{
+				SDL_DestroyWindow(mOffscreenWindow);
+				mOffscreenWindow = nullptr;
+			}
+			if (mFrameDump != nullptr)
+			{
+				std::fclose(mFrameDump);
+				mFrameDump = nullptr;
+			}
 			mMainThreadQueue.process();
 
 			mControlThread.stop();
+			mTelemetry.close();
 
 			auto plugResult = SingleComponentEffect::terminate ();
 			return plugResult;
@@ -199,52 +313,427 @@ namespace Steinberg
 
  		void NapPlugin::onTimer(Timer *timer)
  		{
-			mMainThreadQueue.process();
+			processMainThread();
  		}
 
 
+		void NapPlugin::processMainThread()
+		{
+			// Host callbacks made from here may call straight back into the plugin
+			if (mProcessingMainThread)
+				return;
+			mProcessingMainThread = true;
+			mMainThreadQueue.process();
+			flushParameterEdits();
+			mProcessingMainThread = false;
+		}
+
+
+#if SMTG_OS_LINUX
+		namespace
+		{
+			class RunLoopTimer : public U::Implements<U::Directly<Linux::ITimerHandler>>
+			{
+			public:
+				RunLoopTimer(NapPlugin& plugin) : mPlugin(plugin) { }
+				void PLUGIN_API onTimer() override { mPlugin.onTimer(nullptr); }
+
+			private:
+				NapPlugin& mPlugin;
+			};
+		}
+#endif
+
+
+		bool NapPlugin::startMainThreadTimer()
+		{
+			mTimer = Timer::create(this, 1000.0 / controlRate);
+			if (mTimer != nullptr)
+				return true;
+
+#if SMTG_OS_LINUX
+			if (mRunLoop)
+			{
+				if (!mRunLoopTimer)
+					mRunLoopTimer = owned(new RunLoopTimer(*this));
+				mRunLoopTimerRegistered = mRunLoop->registerTimer(mRunLoopTimer, Linux::TimerInterval(1000.0 / controlRate)) == kResultTrue;
+				return mRunLoopTimerRegistered;
+			}
+#endif
+			return false;
+		}
+
+
+		void NapPlugin::stopMainThreadTimer()
+		{
+			if (mTimer != nullptr)
+			{
+				mTimer->stop();
+				mTimer->release();
+				mTimer = nullptr;
+			}
+
+#if SMTG_OS_LINUX
+			if (mRunLoopTimerRegistered)
+			{
+				mRunLoop->unregisterTimer(mRunLoopTimer);
+				mRunLoopTimerRegistered = false;
+			}
+#endif
+		}
+
+
 		void NapPlugin::control(double deltaTime)
 		{
 			// Begin recording the render commands for the main render window
-			std::lock_guard<std::mutex> lock(mMutex);
+			std::unique_lock<std::mutex> lock(mMutex);
+			auto tickStart = std::chrono::steady_clock::now();
+			mControlQueue.process();
+			updateReloadFade();
+
+			auto governorLevel = mGovernor.getLevel();
+			if (governorLevel != mLoggedGovernorLevel)
+			{
+				if (governorLevel > mLoggedGovernorLevel)
+					nap::Logger::warn("CPU overload, quality reduced to: %s", nap::CPUGovernor::getLevelName(governorLevel));
+				else
+					nap::Logger::info("CPU headroom recovered, quality restored to: %s", nap::CPUGovernor::getLevelName(governorLevel));
+				mLoggedGovernorLevel = governorLevel;
+
+				// The graph's sample rate can't change while processing: the host is asked to reactivate at the factor the level allows,
+				// lower under load and back to the chosen one once the level drops again. The level survives that reactivation.
+				auto factor = getOversamplingFactor();
+				if (mActive && mProcessingMode != kOffline && factor != mOversampler.getPreparedFactor() && !mGovernorRestart)
+				{
+					nap::Logger::info("Reactivating at %dx oversampling", factor);
+					mGovernorRestart = true;
+					mMainThreadQueue.enqueue([this](){
+						if (componentHandler != nullptr)
+							componentHandler->restartComponent(kLatencyChanged);
+					});
+				}
+			}
+
+			// Voices go right away, the quietest first when the pool's policy doesn't say otherwise
+			mVoicePool.setLimit(nap::CPUGovernor::getVoiceLimit(governorLevel, mVoiceCount));
+
+			// Editor frames are the first thing to go under load
+			auto editorWindow = getEditorWindow();
+			bool render = editorWindow != nullptr;
+			if (editorWindow == nullptr)
+				mEditorGesture = false;
+			if (governorLevel == nap::CPUGovernor::ELevel::Minimal)
+				render = false;
+			else if (governorLevel >= nap::CPUGovernor::ELevel::ReducedGUI)
+				render = render && mControlTick % 4 == 0;
+			mControlTick++;
 
 			std::function<void(double)> drawFunc;
-			if (mView != nullptr && mView->isAttached())
+			double buildTime = 0.0;
+			if (render)
 				drawFunc = [&](double deltaTime)
 				{
+					auto buildStart = std::chrono::steady_clock::now();
 					ImGui::Begin("NAP", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
 					if (mParameterGUI != nullptr)
 						mParameterGUI->show(false);
 					ImGui::NewLine();
+					showOversamplingGUI();
+					ImGui::NewLine();
+					showPresetGUI();
+					ImGui::NewLine();
+					showAnalysisGUI();
+					ImGui::NewLine();
+					showVoiceGUI();
+					ImGui::NewLine();
+					showGovernorGUI();
+					showTelemetryGUI();
+					mEditorGesture = ImGui::IsAnyItemActive();
 					std::string formattedText = nap::utility::stringFormat("Framerate: %.02f", mCore->getFramerate());
 					ImGui::Text(formattedText.c_str());
 					ImGui::End();
+					buildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - buildStart).count();
 				};
 			else
 				drawFunc = [](double deltaTime) {};
 
+			applyStagedPreset();
+			updateVoiceRelease();
+			mAnalysisTap.update();
+			dispatchMidiEvents();
 			mCore->update(drawFunc);
+			detectParameterEdits();
+			mTelemetry.midiEventsDequeued();
 
+			// beginFrame blocks on the fence of the frame in flight, endFrame submits and presents
+			auto waitStart = std::chrono::steady_clock::now();
 			mRenderService->beginFrame();
-			if (mView != nullptr && mView->isAttached())
+			auto recordStart = std::chrono::steady_clock::now();
+			if (render)
 			{
-				if (mRenderService->beginRecording(*mView->getRenderWindow()))
+				if (mRenderService->beginRecording(*editorWindow))
 				{
-					mView->getRenderWindow()->beginRendering();
+					editorWindow->beginRendering();
 					mGuiService->draw();
-					mView->getRenderWindow()->endRendering();
+					editorWindow->endRendering();
 					mRenderService->endRecording();
 				}
 			}
+			auto submitStart = std::chrono::steady_clock::now();
 			mRenderService->endFrame();
+
+			auto tickEnd = std::chrono::steady_clock::now();
+			if (render)
+			{
+				double recordTime = std::chrono::duration<double>(submitStart - recordStart).count();
+				double submitTime = std::chrono::duration<double>(tickEnd - submitStart).count();
+				double waitTime = std::chrono::duration<double>(recordStart - waitStart).count();
+				mTelemetry.recordRenderFrame(buildTime, recordTime, submitTime, waitTime);
+				if (mFrameDump != nullptr)
+					std::fprintf(mFrameDump, "%llu,%.1f,%.1f,%.1f,%.1f\n", (unsigned long long)mTelemetry.getLayout().mRenderFrameCount.load(),
+						buildTime * 1e6, recordTime * 1e6, submitTime * 1e6, waitTime * 1e6);
+			}
+			mTelemetry.recordControlTick(std::chrono::duration<double>(tickEnd - tickStart).count(), 1.0 / controlRate);
+
+		}
+
+
+		void NapPlugin::updateSuspension()
+		{
+			// Main thread. Inactive instances without an editor do no periodic work at all.
+			bool suspend = mOfflineStepping || (!mActive && mView == nullptr && mOffscreenRenderWindow == nullptr);
+			if (suspend == mSuspended)
+				return;
+			mSuspended = suspend;
+
+			if (suspend)
+			{
+				mControlThread.disconnectPeriodicTask(mControlSlot);
+				stopMainThreadTimer();
+			}
+			else
+			{
+				processMainThread();
+				if (mHostTimer)
+					startMainThreadTimer();
+				mControlThread.connectPeriodicTask(mControlSlot);
+			}
+		}
+
+
+		void NapPlugin::viewClosed()
+		{
+			mView = nullptr;
+			updateSuspension();
+		}
+
+
+		nap::RenderWindow* NapPlugin::getEditorWindow()
+		{
+			if (mOffscreenRenderWindow != nullptr)
+				return mOffscreenRenderWindow.get();
+#ifdef NAPVST_WITH_EDITOR
+			if (mView != nullptr && mView->isAttached())
+				return mView->getRenderWindow();
+#endif
+			return nullptr;
+		}
+
+
+		void NapPlugin::createOffscreenEditor()
+		{
+			// NAPVST_OFFSCREEN_EDITOR=<width>x<height> renders the editor into a hidden window without a host view.
+			// Meant for measuring GUI cost in CI, combine with SDL_VIDEODRIVER=offscreen and a CPU Vulkan driver such as lavapipe.
+			const char* setting = std::getenv("NAPVST_OFFSCREEN_EDITOR");
+			if (setting == nullptr || setting[0] == '\0')
+				return;
+
+			int width = 400, height = 300;
+			std::sscanf(setting, "%dx%d", &width, &height);
+			mOffscreenWindow = SDL_CreateWindow("NapPlugin offscreen editor", width, height, SDL_WINDOW_VULKAN | SDL_WINDOW_HIDDEN);
+			if (mOffscreenWindow == nullptr)
+			{
+				nap::Logger::error("Failed to create offscreen editor window: %s", SDL_GetError());
+				return;
+			}
+
+			std::atomic<bool> done(false);
+			mControlThread.enqueue([&]()
+			{
+				nap::utility::ErrorState errorState;
+				mOffscreenRenderWindow = std::make_unique<nap::RenderWindow>(*mCore, mOffscreenWindow);
+				if (!mOffscreenRenderWindow->init(errorState))
+				{
+					nap::Logger::error("Failed to create offscreen editor: %s", errorState.toString().c_str());
+					mOffscreenRenderWindow = nullptr;
+				}
+				done = true;
+			});
+			while (!done)
+				mMainThreadQueue.process();
+
+			if (mOffscreenRenderWindow == nullptr)
+			{
+				SDL_DestroyWindow(mOffscreenWindow);
+				mOffscreenWindow = nullptr;
+				return;
+			}
+			nap::Logger::info("Rendering the editor offscreen at %dx%d", width, height);
+
+			// Per frame timings in microseconds, the images themselves stay on the GPU
+			const char* dumpPath = std::getenv("NAPVST_OFFSCREEN_DUMP");
+			if (dumpPath != nullptr && dumpPath[0] != '\0')
+			{
+				mFrameDump = std::fopen(dumpPath, "w");
+				if (mFrameDump != nullptr)
+					std::fprintf(mFrameDump, "frame,build,record,submit,wait\n");
+				else
+					nap::Logger::warn("Unable to write frame timings to: %s", dumpPath);
+			}
+		}
+
+
+		void NapPlugin::showOversamplingGUI()
+		{
+			// Combo index i selects a factor of 2^i
+			const char* factors = "1x\0" "2x\0" "4x\0" "8x\0";
+			int realtimeIndex = std::log2(mRealtimeOversampling.load());
+			int offlineIndex = std::log2(mOfflineOversampling.load());
+			bool changed = false;
+			if (ImGui::Combo("Oversampling", &realtimeIndex, factors))
+			{
+				mRealtimeOversampling = 1 << realtimeIndex;
+				changed = true;
+			}
+			if (ImGui::Combo("Offline oversampling", &offlineIndex, factors))
+			{
+				mOfflineOversampling = 1 << offlineIndex;
+				changed = true;
+			}
+
+			// The host reactivates the plugin and picks up the new latency
+			if (changed)
+				mMainThreadQueue.enqueue([this](){
+					if (componentHandler != nullptr)
+						componentHandler->restartComponent(kLatencyChanged);
+				});
+		}
+
+
+		void NapPlugin::showGovernorGUI()
+		{
+			ImGui::Text("CPU load: %.0f%% (%s)", mGovernor.getLoad() * 100.f, nap::CPUGovernor::getLevelName(mGovernor.getLevel()));
+			ImGui::Text("Quality changes: %llu", (unsigned long long)mGovernor.getLevelChangeCount());
+			if (mAudioWorker.isRunning())
+				ImGui::Text("Worker dropouts: %llu", (unsigned long long)mAudioWorker.getDropoutCount());
+		}
+
+
+		void NapPlugin::showTelemetryGUI()
+		{
+			if (!mTelemetry.isOpen())
+				return;
+
+			auto& layout = mTelemetry.getLayout();
+			ImGui::Text("Blocks: %llu, deadline misses: %llu", (unsigned long long)layout.mBlockCount.load(), (unsigned long long)layout.mDeadlineMissCount.load());
+			ImGui::Text("Block time p50: %.0f%%, p99: %.0f%% of budget", mTelemetry.getBlockTimePercentile(0.5f) * 100.f, mTelemetry.getBlockTimePercentile(0.99f) * 100.f);
+			ImGui::Text("Control overruns: %llu / %llu ticks", (unsigned long long)layout.mControlOverrunCount.load(), (unsigned long long)layout.mControlTickCount.load());
+			ImGui::Text("Render frame: %.2f ms, max %.2f ms", layout.mLastRenderFrameTime.load() / 1000.f, layout.mMaxRenderFrameTime.load() / 1000.f);
+			ImGui::Text("Build %.2f, record %.2f, submit %.2f, wait %.2f ms", layout.mLastBuildTime.load() / 1000.f, layout.mLastRecordTime.load() / 1000.f,
+				layout.mLastSubmitTime.load() / 1000.f, layout.mLastWaitTime.load() / 1000.f);
+			ImGui::Text("Queue high water, control: %u, midi: %u", layout.mControlQueueHighWater.load(), layout.mMidiQueueHighWater.load());
+		}
+
+
+		void NapPlugin::showVoiceGUI()
+		{
+			const char* policies[] = { "Off, the synth steals", "Steal oldest", "Steal quietest", "Retrigger, then steal oldest" };
+			int policy = int(mVoicePool.getPolicy());
+			if (ImGui::Combo("Voice stealing", &policy, policies, IM_ARRAYSIZE(policies)))
+				mVoicePool.setPolicy(nap::VoicePool::EPolicy(policy));
+			ImGui::Text("Voices: %d held, %d releasing of %d, stolen: %llu", mVoicePool.getHeldCount(), mVoicePool.getReleasingCount(),
+				mVoicePool.getCapacity(), (unsigned long long)mVoicePool.getStolenCount());
+			ImGui::Text("MIDI without listeners: %llu, dropped: %llu", (unsigned long long)mMidiRouter.getFilteredCount(), (unsigned long long)mMidiRouter.getDroppedCount());
+		}
+
+
+		void NapPlugin::showAnalysisGUI()
+		{
+			mAnalysisTap.analyse(mSampleRate);
+
+			// Instant attack, roughly 20 dB per second release at 60 frames per second
+			const float release = 0.96f;
+			mPeakHold = std::max(mAnalysisTap.getPeak(), mPeakHold * release);
+			mRMSHold = std::max(mAnalysisTap.getRMS(), mRMSHold * release);
+			auto toMeter = [](float amplitude) { return amplitude > 0.f ? std::clamp((20.f * std::log10(amplitude) + 60.f) / 60.f, 0.f, 1.f) : 0.f; };
+			ImGui::ProgressBar(toMeter(mPeakHold), ImVec2(-1.f, 0.f), nap::utility::stringFormat("Peak %.1f dB", 20.f * std::log10(std::max(mPeakHold, 1e-6f))).c_str());
+			ImGui::ProgressBar(toMeter(mRMSHold), ImVec2(-1.f, 0.f), nap::utility::stringFormat("RMS %.1f dB", 20.f * std::log10(std::max(mRMSHold, 1e-6f))).c_str());
+
+			auto& scope = mAnalysisTap.getScope();
+			ImGui::PlotLines("Scope", scope.data(), scope.size(), 0, nullptr, -1.f, 1.f, ImVec2(0.f, 80.f));
+			auto& spectrum = mAnalysisTap.getSpectrum();
+			ImGui::PlotLines("Spectrum", spectrum.data(), spectrum.size(), 0, nullptr, -90.f, 0.f, ImVec2(0.f, 80.f));
+		}
+
+
+		void NapPlugin::writeMeters(ProcessData& data)
+		{
+			// Audio thread, levels of this block go to the host as read only parameters
+			if (data.outputParameterChanges == nullptr)
+				return;
+
+			int32 queueIndex = 0;
+			int32 pointIndex = 0;
+			if (auto queue = data.outputParameterChanges->addParameterData(kOutputPeakId, queueIndex))
+				queue->addPoint(0, std::min(mAnalysisTap.getPeak(), 1.f), pointIndex);
+			if (auto queue = data.outputParameterChanges->addParameterData(kOutputRMSId, queueIndex))
+				queue->addPoint(0, std::min(mAnalysisTap.getRMS(), 1.f), pointIndex);
+		}
+
+
+		void NapPlugin::showPresetGUI()
+		{
+			ImGui::InputText("Preset name", mPresetName, sizeof(mPresetName));
+			if (ImGui::Button("Save preset") && mPresetName[0] != '\0')
+			{
+				nap::utility::ErrorState errorState;
+				auto index = mPresetBank.save(mPresetName, mParameters, errorState);
+				if (index < 0)
+				{
+					nap::Logger::error(errorState.toString().c_str());
+					return;
+				}
+
+				// Grow the program and morph target lists and let the host reread them
+				std::string name = mPresetBank.getPreset(index).mName;
+				mMainThreadQueue.enqueue([this, name, index]()
+				{
+					Vst::TChar programName[128];
+					Steinberg::Vst::StringConvert::convert(name, programName);
+					mPresetList->addProgram(programName);
+					static_cast<StringListParameter*>(mPresetList->getParameter())->appendString(programName);
+					mMorphTargetParameter->appendString(programName);
+					mHostPresetCount = index + 1;
+					notifyProgramListChange(kPresetId, -1);
+					if (componentHandler != nullptr)
+						componentHandler->restartComponent(kParamTitlesChanged | kParamValuesChanged);
+				});
+				mPresetName[0] = '\0';
+			}
 		}
 
 
 		tresult PLUGIN_API NapPlugin::process (ProcessData& data)
 		{
+			auto processStart = std::chrono::steady_clock::now();
+
 			// Process parameters
+			mControllerPoints.clear();
+			mControllerQueues.clear();
 			if (data.inputParameterChanges)
 			{
+				bool presetChanged = false;
+				int32 presetOffset = 0;
 				int32 numParamsChanged = data.inputParameterChanges->getParameterCount ();
 				for (int32 index = 0; index < numParamsChanged; index++)
 				{
@@ -261,63 +750,74 @@ namespace Steinberg
 								mBypass = (value > 0.5f);
 						}
 
-						int paramId = 1; // start from 1, 0 is reserved for bypass
-						for (auto& parameter : mParameters)
+						if (paramQueue->getParameterId() == kPresetId || paramQueue->getParameterId() == kMorphTargetId || paramQueue->getParameterId() == kMorphId)
 						{
-							if (paramQueue->getParameterId() == paramId++)
+							if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) == kResultTrue)
 							{
-								if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) == kResultTrue)
-								{
-									auto floatParam = rtti_cast<nap::ParameterFloat>(parameter);
-									if (floatParam != nullptr)
-										mControlThread.enqueue([floatParam, value](){
-											floatParam->setValue(nap::math::fit<float>(value, 0.f, 1.f, floatParam->mMinimum, floatParam->mMaximum));
-										});
-									auto intParam = rtti_cast<nap::ParameterInt>(parameter);
-									if (intParam != nullptr)
-										mControlThread.enqueue([intParam, value](){
-											intParam->setValue(nap::math::fit<float>(value, 0.f, 1.f, intParam->mMinimum, intParam->mMaximum));
-										});
-									auto optionParam = rtti_cast<nap::ParameterDropDown>(parameter);
-									if (optionParam != nullptr)
-										mControlThread.enqueue([optionParam, value](){
-											optionParam->setSelectedIndex(nap::math::fit<float>(value, 0.f, 1.f, 0, optionParam->mItems.size() - 1));
-										});
-								}
+								// Normalized values are steps of the list the host knows, it may lag behind the bank
+								auto lastPreset = std::max(mHostPresetCount.load() - 1, 0);
+								auto index = std::min<int>(std::lround(value * lastPreset), lastPreset);
+								if (paramQueue->getParameterId() == kPresetId)
+									mPresetIndex = index;
+								else if (paramQueue->getParameterId() == kMorphTargetId)
+									mMorphTargetIndex = index;
+								else
+									mMorphAmount = value;
+								presetChanged = true;
+								presetOffset = sampleOffset;
 							}
 						}
-					}
-				}
-			}
 
-			// Process note events
-			auto events = data.inputEvents;
-			if (events)
-			{
-				int32 count = events->getEventCount ();
-				for (int32 i = 0; i < count; i++)
-				{
-					Vst::Event e;
-					events->getEvent (i, e);
-					switch (e.type)
-					{
-						case Vst::Event::kNoteOnEvent:
+						// MIDI controllers mapped by the host, every point is passed on together with the note events
+						int controllerIndex = paramQueue->getParameterId() - kMidiControllerId;
+						if (controllerIndex >= 0 && controllerIndex < mControllerValues.size())
 						{
-							auto midiEvent = std::make_unique<nap::MidiEvent>(nap::MidiEvent::Type::noteOn, e.noteOn.pitch, e.noteOn.velocity * 127);
-							mMidiService->enqueueEvent(std::move(midiEvent));
-							break;
+							ControllerQueue queue = { int(mControllerPoints.size()), 0 };
+							for (int32 point = 0; point < numPoints && mControllerPoints.size() < mControllerPoints.capacity(); ++point)
+								if (paramQueue->getPoint (point, sampleOffset, value) == kResultTrue)
+									mControllerPoints.push_back({ sampleOffset, controllerIndex, float(value) });
+							queue.mEnd = mControllerPoints.size();
+							if (queue.mEnd > queue.mNext && mControllerQueues.size() < mControllerQueues.capacity())
+								mControllerQueues.push_back(queue);
+							continue;
 						}
-						case Vst::Event::kNoteOffEvent:
+
+						// NAP parameters are looked up on the control thread, a reload may have replaced them by then.
+						// Host values lag behind while the editor drags a parameter, those are dropped.
+						int parameterIndex = paramQueue->getParameterId() - (kBypassId + 1);
+						if (parameterIndex >= 0 && paramQueue->getParameterId() < kPresetId)
 						{
-							auto midiEvent = std::make_unique<nap::MidiEvent>(nap::MidiEvent::Type::noteOff, e.noteOn.pitch, 0);
-							mMidiService->enqueueEvent(std::move(midiEvent));
-							break;
+							if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) == kResultTrue)
+							{
+								mTelemetry.controlTaskEnqueued();
+								enqueueControlTask([this, parameterIndex, value](){
+									auto parameter = parameterIndex < mParameters.size() ? mParameters[parameterIndex] : nullptr;
+									if (parameter != nullptr && !mEditorHeld[parameterIndex])
+										applyParameterValue(parameterIndex, nap::denormalizeParameterValue(*parameter, value));
+									mTelemetry.controlTaskDequeued();
+								});
+							}
 						}
-						default:
-							continue;
 					}
 				}
+
+				if (presetChanged)
+					stagePreset(data.outputParameterChanges, presetOffset);
 			}
+			beginMidiInput(data.inputEvents);
+
+			// Voices past their release are free again for this block's notes
+			mVoicePool.advance(data.numSamples);
+
+			writeParameterEdits(data);
+
+			// Offline renders step the control logic themselves, see processOffline()
+			if (mOfflineStepping)
+				return processOffline(data);
+
+			// Process note events and MIDI controllers, in the order the host placed them in the block
+			while (getNextMidiInputOffset() >= 0)
+				handleNextMidiInput();
 
 			// Process audio
 			if (data.numOutputs == 0)
@@ -328,30 +828,461 @@ namespace Steinberg
 
 			if (data.numSamples > 0)
 			{
-				if (data.numSamples != mAudioService->getNodeManager().getInternalBufferSize())
-					mAudioService->getNodeManager().setInternalBufferSize(data.numSamples);
-
 				// Process Algorithm
-				mAudioService->onAudioCallback(data.numInputs > 0 ? data.inputs[0].channelBuffers32 : nullptr, data.outputs[0].channelBuffers32, data.numSamples);
+				float** inputs = gatherChannels(data.inputs, data.numInputs, mInputBusChannels, mInputPointers, mSilence);
+				float** outputs = gatherChannels(data.outputs, data.numOutputs, mOutputBusChannels, mOutputPointers, mDiscard);
+				if (mAudioWorker.isRunning())
+					mAudioWorker.process(inputs, outputs, data.numSamples);
+				else
+					renderAudio(inputs, outputs, data.numSamples);
+
+				mAnalysisTap.write(outputs, mOutputBusChannels[0], data.numSamples);
+				writeMeters(data);
+
+				// Offline renders have no deadline to meet
+				if (mProcessingMode != kOffline)
+				{
+					// The worker times its own rendering, here only the handoff would be measured
+					std::chrono::duration<double> processTime = std::chrono::steady_clock::now() - processStart;
+					if (!mAudioWorker.isRunning())
+						mGovernor.addMeasurement(processTime.count(), data.numSamples / mSampleRate);
+					mTelemetry.recordBlock(processTime.count(), data.numSamples / mSampleRate);
+				}
+			}
+
+			return kResultOk;
+		}
+
+
+		tresult NapPlugin::processOffline(ProcessData& data)
+		{
+			// The host thread takes over from the control thread: notes are applied at their sample offset and
+			// mCore->update runs every offlineControlInterval samples, so the same project renders the same way every time
+			mOfflineInputs = data.numOutputs > 0 ? gatherChannels(data.inputs, data.numInputs, mInputBusChannels, mInputPointers, mSilence) : nullptr;
+			mOfflineOutputs = data.numOutputs > 0 ? gatherChannels(data.outputs, data.numOutputs, mOutputBusChannels, mOutputPointers, mDiscard) : nullptr;
+			mOfflineStepper.process(data.numSamples);
+
+			if (mOfflineOutputs != nullptr && data.numSamples > 0)
+			{
+				// Running hash of the main output, logged on deactivation to compare renders
+				mOfflineStepper.hash(mOfflineOutputs, mOutputBusChannels[0], data.numSamples);
+				mAnalysisTap.write(mOfflineOutputs, mOutputBusChannels[0], data.numSamples);
+				writeMeters(data);
 			}
 
 			return kResultOk;
 		}
 
 
+		void NapPlugin::beginMidiInput(IEventList* events)
+		{
+			// Audio thread, nothing is sorted: every queue and the event list come in order already
+			mNextControllerQueue = -1;
+			mInputEvents = events;
+			mInputEventCount = events != nullptr ? events->getEventCount() : 0;
+			mInputEventIndex = 0;
+		}
+
+
+		int NapPlugin::getNextMidiInputOffset()
+		{
+			// Events the host fails to hand over are skipped
+			while (mInputEventIndex < mInputEventCount && mInputEvents->getEvent(mInputEventIndex, mInputEvent) != kResultOk)
+				mInputEventIndex++;
+
+			// The earliest head of the controller queues, there are only as many as controllers moved in this block.
+			// At equal offsets the queue order is kept and controllers go before notes.
+			mNextControllerQueue = -1;
+			for (auto i = 0; i < mControllerQueues.size(); ++i)
+			{
+				auto& queue = mControllerQueues[i];
+				if (queue.mNext < queue.mEnd && (mNextControllerQueue < 0 || mControllerPoints[queue.mNext].mSampleOffset < mControllerPoints[mControllerQueues[mNextControllerQueue].mNext].mSampleOffset))
+					mNextControllerQueue = i;
+			}
+
+			bool eventPending = mInputEventIndex < mInputEventCount;
+			if (mNextControllerQueue >= 0)
+			{
+				auto offset = mControllerPoints[mControllerQueues[mNextControllerQueue].mNext].mSampleOffset;
+				if (!eventPending || offset <= mInputEvent.sampleOffset)
+					return std::max<int>(offset, 0);
+				mNextControllerQueue = -1;
+			}
+			return eventPending ? std::max<int>(mInputEvent.sampleOffset, 0) : -1;
+		}
+
+
+		void NapPlugin::handleNextMidiInput()
+		{
+			// Call after getNextMidiInputOffset(), which picked the next input
+			if (mNextControllerQueue >= 0)
+			{
+				auto& point = mControllerPoints[mControllerQueues[mNextControllerQueue].mNext++];
+				handleControllerChange(point.mIndex, point.mValue);
+				mNextControllerQueue = -1;
+			}
+			else if (mInputEventIndex < mInputEventCount)
+			{
+				handleNoteEvent(mInputEvent);
+				mInputEventIndex++;
+			}
+		}
+
+
+		void NapPlugin::renderOffline(int offset, int numSamples)
+		{
+			if (mOfflineOutputs == nullptr)
+				return;
+			for (auto channel = 0; channel < mInputPointers.size(); ++channel)
+				mOfflineInputPointers[channel] = mOfflineInputs[channel] + offset;
+			for (auto channel = 0; channel < mOutputPointers.size(); ++channel)
+				mOfflineOutputPointers[channel] = mOfflineOutputs[channel] + offset;
+			renderAudio(mOfflineInputs != nullptr ? mOfflineInputPointers.data() : nullptr, mOfflineOutputPointers.data(), numSamples);
+		}
+
+
+		void NapPlugin::stepControl()
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mControlQueue.process();
+			applyStagedPreset();
+			updateVoiceRelease();
+			dispatchMidiEvents();
+			std::function<void(double)> updateFunc = [](double deltaTime) {};
+			mCore->update(updateFunc);
+			mTelemetry.midiEventsDequeued();
+		}
+
+
+		void NapPlugin::handleNoteEvent(const Vst::Event& e)
+		{
+			switch (e.type)
+			{
+				case Vst::Event::kNoteOnEvent:
+				{
+					// A stolen or retriggered note is released first
+					auto released = mVoicePool.noteOn(e.noteOn.channel, e.noteOn.pitch, e.noteOn.noteId, e.noteOn.velocity);
+					if (released.isValid())
+						enqueueMidiEvent(nap::MidiRouter::EType::NoteOff, released.mChannel, released.mPitch, 0);
+					enqueueMidiEvent(nap::MidiRouter::EType::NoteOn, e.noteOn.channel, e.noteOn.pitch, e.noteOn.velocity * 127);
+					break;
+				}
+				case Vst::Event::kNoteOffEvent:
+				{
+					// Stolen notes were released already, notes still held by another voice wait for that one
+					if (mVoicePool.noteOff(e.noteOff.channel, e.noteOff.pitch, e.noteOff.noteId))
+						enqueueMidiEvent(nap::MidiRouter::EType::NoteOff, e.noteOff.channel, e.noteOff.pitch, 0);
+					break;
+				}
+				default:
+					break;
+			}
+		}
+
+
+		void NapPlugin::configureVoicePool()
+		{
+			// The pool hands out as many voices as the synth's Polyphonic object has
+			int voiceCount = 16;
+			auto polyphonic = mCore->getResourceManager()->findObject("Polyphonic");
+			if (polyphonic != nullptr)
+			{
+				auto property = polyphonic->get_type().get_property("VoiceCount");
+				if (property.is_valid())
+					voiceCount = property.get_value(*polyphonic).to_int();
+			}
+			mVoiceCount = voiceCount;
+			mVoicePool.setCapacity(voiceCount);
+
+			// Voices stay busy for the envelope's release, which the Release parameter sets in milliseconds
+			mReleaseParameter = nullptr;
+			for (auto i = 0; i < mParameters.size(); ++i)
+				if (mParameters[i] != nullptr && mParameterIDs[i] == "Release")
+					mReleaseParameter = mParameters[i];
+		}
+
+
+		void NapPlugin::updateVoiceRelease()
+		{
+			// Note offs reach the synth at the next control tick
+			double release = 1.0 / controlRate;
+			if (mReleaseParameter != nullptr)
+				release += nap::getParameterValue(*mReleaseParameter) / 1000.0;
+			mVoicePool.setReleaseLength(std::ceil(release * mSampleRate));
+		}
+
+
+		void NapPlugin::enqueueControlTask(std::function<void()> task)
+		{
+			// Run by the next control tick or, while stepping offline, by the next step in process()
+			mControlQueue.enqueue(std::move(task));
+		}
+
+
+		void NapPlugin::enqueueMidiEvent(nap::MidiRouter::EType type, int channel, int number, int value)
+		{
+			// Audio thread, events nobody listens to stop here. The control thread creates the MidiEvents.
+			if (mMidiRouter.push(type, channel, number, value))
+				mTelemetry.midiEventEnqueued();
+		}
+
+
+		std::vector<nap::MidiRouter::Filter> NapPlugin::getMidiFilters()
+		{
+			// Control thread. MidiInputComponent has a boolean property per message type, missing ones count as listening.
+			const char* typeProperties[] = { "NoteOff", "NoteOn", "Aftertouch", "ControlChange", "ProgramChange", "ChannelPressure", "PitchBend" };
+			static_assert(IM_ARRAYSIZE(typeProperties) == int(nap::MidiRouter::EType::Count), "One property per MIDI type");
+
+			std::vector<nap::MidiRouter::Filter> filters;
+			for (auto& component : mCore->getResourceManager()->getObjects<nap::MidiInputComponent>())
+			{
+				nap::MidiRouter::Filter filter;
+				for (auto type = 0; type < int(nap::MidiRouter::EType::Count); ++type)
+				{
+					auto property = component->get_type().get_property(typeProperties[type]);
+					filter.mTypes[type] = !property.is_valid() || property.get_value(*component).to_bool();
+				}
+				filter.mChannels.assign(component->mChannels.begin(), component->mChannels.end());
+				filter.mNumbers.assign(component->mNumbers.begin(), component->mNumbers.end());
+				filter.mPorts = component->mPorts;
+				filters.emplace_back(std::move(filter));
+			}
+			return filters;
+		}
+
+
+		void NapPlugin::dispatchMidiEvents()
+		{
+			// Control thread, right before Core::update hands the events to the components
+			mMidiRouter.dispatch([this](nap::MidiRouter::EType type, int channel, int number, int value)
+			{
+				const nap::MidiEvent::Type types[] = { nap::MidiEvent::Type::noteOff, nap::MidiEvent::Type::noteOn, nap::MidiEvent::Type::afterTouch,
+					nap::MidiEvent::Type::controlChange, nap::MidiEvent::Type::programChange, nap::MidiEvent::Type::channelPressure, nap::MidiEvent::Type::pitchBend };
+				mMidiService->enqueueEvent(std::make_unique<nap::MidiEvent>(types[int(type)], number, value, channel));
+			});
+		}
+
+
+		void NapPlugin::handleControllerChange(int controllerIndex, float value)
+		{
+			// Audio thread. Host automation is much finer than MIDI, only changes of the MIDI value are passed on.
+			int channel = controllerIndex / midiControllerCount;
+			int controller = controllerIndex % midiControllerCount;
+			int midiValue = std::lround(value * (controller == kPitchBend ? 16383 : 127));
+			if (midiValue == mControllerValues[controllerIndex])
+				return;
+			mControllerValues[controllerIndex] = midiValue;
+
+			if (controller == kPitchBend)
+				enqueueMidiEvent(nap::MidiRouter::EType::PitchBend, channel, midiValue & 0x7f, midiValue >> 7);
+			else if (controller == kAfterTouch)
+				enqueueMidiEvent(nap::MidiRouter::EType::ChannelPressure, channel, midiValue, 0);
+			else
+				enqueueMidiEvent(nap::MidiRouter::EType::ControlChange, channel, controller, midiValue);
+		}
+
+
+		tresult PLUGIN_API NapPlugin::getMidiControllerAssignment(int32 busIndex, int16 channel, CtrlNumber midiControllerNumber, ParamID& id)
+		{
+			if (busIndex != 0 || channel < 0 || channel >= nap::MidiRouter::channelCount || midiControllerNumber < 0 || midiControllerNumber >= midiControllerCount)
+				return kResultFalse;
+			id = kMidiControllerId + channel * midiControllerCount + midiControllerNumber;
+			return kResultTrue;
+		}
+
+
+		void NapPlugin::renderAudio(float** inputs, float** outputs, int numSamples)
+		{
+			mOversampler.process(inputs, outputs, numSamples);
+			applyOutputFade(outputs, numSamples);
+		}
+
+
+		void NapPlugin::renderWorkerAudio(float** inputs, float** outputs, int numSamples)
+		{
+			// While the worker runs the audio thread only hands blocks over, the governor is fed from here instead
+			auto renderStart = std::chrono::steady_clock::now();
+			renderAudio(inputs, outputs, numSamples);
+			std::chrono::duration<double> renderTime = std::chrono::steady_clock::now() - renderStart;
+			mGovernor.addMeasurement(renderTime.count(), numSamples / mSampleRate);
+		}
+
+
+		void NapPlugin::renderGraph(float** inputs, float** outputs, int numSamples)
+		{
+			if (numSamples != mAudioService->getNodeManager().getInternalBufferSize())
+				mAudioService->getNodeManager().setInternalBufferSize(numSamples);
+
+			mAudioService->onAudioCallback(inputs, outputs, numSamples);
+		}
+
+
 		tresult PLUGIN_API NapPlugin::setActive (TBool state)
 		{
+			if (!mHostTimer)
+				processMainThread();
+
+			if (state)
+			{
+				// Reactivations the governor asked for keep its level, any other one starts at full quality
+				if (!mGovernorRestart.exchange(false) || mProcessingMode == kOffline)
+					mGovernor.reset();
+				mControllerValues.fill(-1);
+
+				// Audio buffers of one activation all come from the scratch arena
+				mAudioWorker.stop();
+				mOversampler.release();
+				mScratchMemory.release();
+				prepareRouting();
+
+				// The graph runs at the oversampled rate, the factor is picked here so a latency restart can change it
+				auto& nodeManager = mAudioService->getNodeManager();
+				auto factor = getOversamplingFactor();
+				nodeManager.setSampleRate(mSampleRate * factor);
+				nodeManager.setInternalBufferSize(mMaxSamplesPerBlock * factor);
+				mOversampler.prepare(nodeManager.getInputChannelCount(), nodeManager.getOutputChannelCount(), mMaxSamplesPerBlock, factor, mScratchMemory);
+
+				if (mUseAudioWorker)
+					mAudioWorker.start(nodeManager.getInputChannelCount(), nodeManager.getOutputChannelCount(), mMaxSamplesPerBlock, mScratchMemory);
+				nap::Logger::info("Audio scratch memory: %zu of %zu KB in %d chunks, %d on huge pages", mScratchMemory.getUsedSize() / 1024,
+					mScratchMemory.getReservedSize() / 1024, mScratchMemory.getChunkCount(), mScratchMemory.getHugePageChunkCount());
+
+				mActive = true;
+				updateSuspension();
+
+				// Parameter changes that came in while inactive are applied before the first process() call.
+				// Done here rather than waiting for the control thread, which only holds the mutex for one tick.
+				{
+					std::lock_guard<std::mutex> lock(mMutex);
+					mControlQueue.process();
+					mLoggedGovernorLevel = mGovernor.getLevel();
+				}
+
+				// Renders start from the same state: no notes held and fresh oversampler history, the graph was told the rate again above.
+				// The synth gets note offs for what the pool still holds, tails of notes it never tracked can carry over.
+				if (mProcessingMode == kOffline)
+				{
+					nap::VoicePool::Note notes[nap::VoicePool::maxCapacity];
+					auto noteCount = mVoicePool.getHeldNotes(notes, nap::VoicePool::maxCapacity);
+					for (auto i = 0; i < noteCount; ++i)
+						enqueueMidiEvent(nap::MidiRouter::EType::NoteOff, notes[i].mChannel, notes[i].mPitch, 0);
+					mVoicePool.reset();
+				}
+
+				mOfflineStepping = mProcessingMode == kOffline;
+				mOfflineStepper.reset(offlineControlInterval, mSampleRate);
+				updateSuspension();
+			}
+			else
+			{
+				if (mOfflineStepping)
+				{
+					nap::Logger::info("Offline render: %llu samples, output hash %08x", (unsigned long long)mOfflineStepper.getSampleCount(), mOfflineStepper.getHash());
+					mOfflineStepping = false;
+				}
+
+				// Buffers are allocated and zeroed again on activation, which also faults their pages in
+				mAudioWorker.stop();
+				mOversampler.release();
+				mSilence = nullptr;
+				mDiscard = nullptr;
+				mScratchMemory.release();
+
+				mActive = false;
+				updateSuspension();
+			}
+
+			if (!mHostTimer)
+				processMainThread();
 			return kResultOk;
 		}
 
 
 		tresult PLUGIN_API NapPlugin::setState (IBStream* state)
 		{
-			IBStreamer streamer (state, kLittleEndian);
-			int32 savedBypass = 0;
-			if (!streamer.readInt32 (savedBypass))
-				return kResultFalse;
-			mBypass = savedBypass > 0;
+			if (!mHostTimer)
+				processMainThread();
+
+			// The whole chunk is read first, see nap::PluginState for the layout
+			std::vector<char> data;
+			char buffer[4096];
+			int32 bytesRead = 0;
+			while (state->read(buffer, sizeof(buffer), &bytesRead) == kResultOk && bytesRead > 0)
+				data.insert(data.end(), buffer, buffer + bytesRead);
+
+			// Parameters are added by resource reloads on the control thread, which holds the mutex while it does
+			nap::PluginState savedState;
+			std::vector<float> normalizedValues;
+			bool layoutMatches = false;
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				auto result = savedState.read(data.data(), data.size(), getIntegralLayout());
+				if (result == nap::PluginState::EReadResult::Invalid)
+					return kResultFalse;
+
+				if (result == nap::PluginState::EReadResult::BypassOnly)
+				{
+					mBypass = savedState.mBypass;
+					SingleComponentEffect::setParamNormalized(kBypassId, mBypass ? 1.0 : 0.0);
+					return kResultOk;
+				}
+
+				layoutMatches = savedState.mSchemaHash == nap::getParameterSchemaHash(mParameters) && savedState.mValues.size() == mParameters.size();
+				if (layoutMatches)
+					for (auto i = 0; i < mParameters.size(); ++i)
+						normalizedValues.emplace_back(mParameters[i] != nullptr ? nap::normalizeParameterValue(*mParameters[i], savedState.mValues[i]) : 0.f);
+			}
+
+			mBypass = savedState.mBypass;
+			SingleComponentEffect::setParamNormalized(kBypassId, mBypass ? 1.0 : 0.0);
+
+			// Only the selection is restored, the parameter values below already hold the preset's result
+			auto lastPreset = std::max(mHostPresetCount.load() - 1, 0);
+			if (savedState.mPresetIndex <= lastPreset && savedState.mMorphTargetIndex <= lastPreset)
+			{
+				mPresetIndex = savedState.mPresetIndex;
+				mMorphTargetIndex = savedState.mMorphTargetIndex;
+				mMorphAmount = savedState.mMorphAmount;
+				SingleComponentEffect::setParamNormalized(kPresetId, lastPreset > 0 ? double(mPresetIndex) / lastPreset : 0.0);
+				SingleComponentEffect::setParamNormalized(kMorphTargetId, lastPreset > 0 ? double(mMorphTargetIndex) / lastPreset : 0.0);
+				SingleComponentEffect::setParamNormalized(kMorphId, mMorphAmount);
+			}
+			else
+				nap::Logger::warn("Saved preset selection is not in the preset bank, it is not restored");
+
+			if (savedState.mRealtimeOversampling != mRealtimeOversampling || savedState.mOfflineOversampling != mOfflineOversampling)
+			{
+				mRealtimeOversampling = savedState.mRealtimeOversampling;
+				mOfflineOversampling = savedState.mOfflineOversampling;
+				if (componentHandler != nullptr)
+					componentHandler->restartComponent(kLatencyChanged);
+			}
+
+			if (!layoutMatches)
+			{
+				nap::Logger::warn("Parameter layout changed since the state was saved, parameter values are not restored");
+				return kResultOk;
+			}
+
+			// Keep the host side in sync, then apply everything in one go on the control thread
+			for (auto i = 0; i < normalizedValues.size(); ++i)
+				SingleComponentEffect::setParamNormalized(kBypassId + 1 + i, normalizedValues[i]);
+
+			mTelemetry.controlTaskEnqueued();
+			enqueueControlTask([this, values = std::move(savedState.mValues)]()
+			{
+				for (auto i = 0; i < values.size() && i < mParameters.size(); ++i)
+					if (mParameters[i] != nullptr)
+						applyParameterValue(i, values[i]);
+				mTelemetry.controlTaskDequeued();
+			});
+
+			// No control ticks while suspended, a getState() right after should see the values
+			if (mSuspended && !mOfflineStepping)
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mControlQueue.process();
+			}
 
 			return kResultOk;
 		}
@@ -359,35 +1290,162 @@ namespace Steinberg
 
 		tresult PLUGIN_API NapPlugin::getState (IBStream* state)
 		{
-			IBStreamer streamer (state, kLittleEndian);
+			if (!mHostTimer)
+				processMainThread();
 
-			streamer.writeInt32 (mBypass ? 1 : 0);
+			std::vector<char> data;
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				nap::PluginState currentState;
+				currentState.mBypass = mBypass;
+				currentState.mRealtimeOversampling = mRealtimeOversampling;
+				currentState.mOfflineOversampling = mOfflineOversampling;
+				currentState.mPresetIndex = mPresetIndex;
+				currentState.mMorphTargetIndex = mMorphTargetIndex;
+				currentState.mMorphAmount = mMorphAmount;
+				currentState.mSchemaHash = nap::getParameterSchemaHash(mParameters);
+				currentState.mValues.reserve(mParameters.size());
+				for (auto parameter : mParameters)
+					currentState.mValues.emplace_back(parameter != nullptr ? nap::getParameterValue(*parameter) : 0.f);
+				data = currentState.write(getIntegralLayout());
+			}
 
+			int32 bytesWritten = 0;
+			if (state->write(data.data(), data.size(), &bytesWritten) != kResultOk || bytesWritten != data.size())
+				return kResultFalse;
 			return kResultOk;
 		}
 
 
+		std::vector<bool> NapPlugin::getIntegralLayout() const
+		{
+			std::vector<bool> integral;
+			integral.reserve(mParameters.size());
+			for (auto parameter : mParameters)
+				integral.emplace_back(parameter != nullptr && nap::isIntegralParameter(*parameter));
+			return integral;
+		}
+
+
 		tresult PLUGIN_API NapPlugin::setupProcessing (ProcessSetup& newSetup)
 		{
 			// called before the process call, always in a disable state (not active)
 			// here we keep a trace of the processing mode (offline,...) for example.
-			mAudioService->getNodeManager().setSampleRate(newSetup.sampleRate);
-			mAudioService->getNodeManager().setInternalBufferSize(newSetup.maxSamplesPerBlock);
-
+			// The node manager is configured in setActive, once the oversampling factor is known.
 			mProcessingMode = newSetup.processMode;
+			mSampleRate = newSetup.sampleRate;
+			mMaxSamplesPerBlock = newSetup.maxSamplesPerBlock;
+
+			// Offline renders are not bound to a deadline, pipelining would only add latency there
+#ifdef NAPVST_ASYNC_PROCESSING
+			mUseAudioWorker = mProcessingMode != kOffline;
+#endif
+
 			return SingleComponentEffect::setupProcessing (newSetup);
 		}
 
 
+		uint32 PLUGIN_API NapPlugin::getLatencySamples ()
+		{
+			// While active the oversampler runs at the factor it was prepared with, a changed setting waits for the restart
+			uint32 latency = nap::Oversampler::getLatencySamples(mActive ? mOversampler.getPreparedFactor() : getOversamplingFactor());
+			if (mUseAudioWorker)
+				latency += mMaxSamplesPerBlock;
+			return latency;
+		}
+
+
+		int NapPlugin::getOversamplingFactor() const
+		{
+			if (mProcessingMode == kOffline)
+				return mOfflineOversampling.load();
+			return nap::CPUGovernor::getOversamplingLimit(mGovernor.getLevel(), mRealtimeOversampling.load());
+		}
+
+
 		tresult PLUGIN_API NapPlugin::setBusArrangements (SpeakerArrangement* inputs, int32 numIns,
 		                                                    SpeakerArrangement* outputs, int32 numOuts)
 		{
+			// Every bus takes any of the supported layouts, channel counts are applied in setActive
+			if (numIns != getBusCount(kAudio, kInput) || numOuts != getBusCount(kAudio, kOutput))
+				return kResultFalse;
+			for (auto i = 0; i < numIns; ++i)
+				if (!isSupportedArrangement(inputs[i]))
+					return kResultFalse;
+			for (auto i = 0; i < numOuts; ++i)
+				if (!isSupportedArrangement(outputs[i]))
+					return kResultFalse;
+
+			return SingleComponentEffect::setBusArrangements (inputs, numIns, outputs, numOuts);
+		}
+
+
+		bool NapPlugin::isSupportedArrangement(SpeakerArrangement arrangement)
+		{
+			return arrangement == SpeakerArr::kMono || arrangement == SpeakerArr::kStereo ||
+				arrangement == SpeakerArr::k51 || arrangement == SpeakerArr::k71_4;
+		}
+
+
+		void NapPlugin::prepareRouting()
+		{
+			auto collect = [this](BusDirection direction, std::vector<int>& busChannels)
+			{
+				busChannels.clear();
+				int channelCount = 0;
+				for (auto bus = 0; bus < getBusCount(kAudio, direction); ++bus)
+				{
+					SpeakerArrangement arrangement = 0;
+					getBusArrangement(direction, bus, arrangement);
+					busChannels.emplace_back(SpeakerArr::getChannelCount(arrangement));
+					channelCount += busChannels.back();
+				}
+				return channelCount;
+			};
+
+			auto inputChannelCount = collect(kInput, mInputBusChannels);
+			auto outputChannelCount = collect(kOutput, mOutputBusChannels);
+			mInputPointers.assign(inputChannelCount, nullptr);
+			mOutputPointers.assign(outputChannelCount, nullptr);
+			mOfflineInputPointers.assign(inputChannelCount, nullptr);
+			mOfflineOutputPointers.assign(outputChannelCount, nullptr);
+			mSilence = mScratchMemory.allocateFloats(mMaxSamplesPerBlock);
+			mDiscard = mScratchMemory.allocateFloats(mMaxSamplesPerBlock);
+
 			auto& nodeManager = mAudioService->getNodeManager();
-			nodeManager.setInputChannelCount(numIns);
-			nodeManager.setOutputChannelCount(numOuts);
+			if (nodeManager.getInputChannelCount() != inputChannelCount || nodeManager.getOutputChannelCount() != outputChannelCount)
+			{
+				nodeManager.setInputChannelCount(inputChannelCount);
+				nodeManager.setOutputChannelCount(outputChannelCount);
+				nap::Logger::info("Audio channels: %d in, %d out, main output on 0 to %d, stems on %d to %d",
+					inputChannelCount, outputChannelCount, mOutputBusChannels[0] - 1, mOutputBusChannels[0], outputChannelCount - 1);
+
+				// The routing is fixed in objects.json, wider layouts can leave channels without a source
+				size_t routedChannelCount = 0;
+				for (auto& output : mCore->getResourceManager()->getObjects<nap::audio::OutputComponent>())
+					routedChannelCount = std::max(routedChannelCount, output->mChannelRouting.size());
+				if (routedChannelCount < outputChannelCount)
+					nap::Logger::warn("Output channels %d to %d are not routed in objects.json and stay silent", int(routedChannelCount), outputChannelCount - 1);
+			}
+		}
 
-			SingleComponentEffect::setBusArrangements (inputs, numIns, outputs, numOuts);
-			return kResultFalse;
+
+		float** NapPlugin::gatherChannels(AudioBusBuffers* buses, int32 busCount, const std::vector<int>& busChannelCounts, std::vector<float*>& pointers, float* missing)
+		{
+			// Audio thread, no samples are copied
+			if (pointers.empty())
+				return nullptr;
+
+			int index = 0;
+			for (auto bus = 0; bus < busChannelCounts.size(); ++bus)
+			{
+				for (auto channel = 0; channel < busChannelCounts[bus]; ++channel)
+				{
+					float* pointer = bus < busCount && channel < buses[bus].numChannels ? buses[bus].channelBuffers32[channel] : nullptr;
+					pointers[index++] = pointer != nullptr ? pointer : missing;
+				}
+			}
+			return pointers.data();
 		}
 
 
@@ -406,12 +1464,18 @@ namespace Steinberg
 
 		IPlugView* PLUGIN_API NapPlugin::createView (const char* name)
 		{
+#ifdef NAPVST_WITH_EDITOR
 			if (mView != nullptr)
 				return nullptr;
 
 			ViewRect rect = ViewRect(0, 0, 400, 300);
 			mView = new NapPluginView(*this, mMainThreadQueue, rect);
+			updateSuspension();
 			return mView;
+#else
+			// Audio only build
+			return nullptr;
+#endif
 		}
 
 
@@ -431,10 +1495,21 @@ namespace Steinberg
 		{
 			// called from host to update our parameters state
 			tresult result = SingleComponentEffect::setParamNormalized (tag, value);
+			if (!mHostTimer)
+				processMainThread();
 			return result;
 		}
 
 
+		ParamValue PLUGIN_API NapPlugin::getParamNormalized(ParamID tag)
+		{
+			// Hosts poll this from their UI thread, which makes it the regular entry point without a timer
+			if (!mHostTimer)
+				processMainThread();
+			return SingleComponentEffect::getParamNormalized(tag);
+		}
+
+
 		tresult PLUGIN_API NapPlugin::getParamStringByValue(ParamID tag, ParamValue valueNormalized, String128 string)
 		{
 			return SingleComponentEffect::getParamStringByValue(tag, valueNormalized, string);
@@ -449,50 +1524,360 @@ namespace Steinberg
 
 		tresult PLUGIN_API NapPlugin::queryInterface(const TUID iid, void** obj)
 		{
+			QUERY_INTERFACE(iid, obj, IMidiMapping::iid, IMidiMapping)
 			return SingleComponentEffect::queryInterface(iid, obj);
 		}
 
 
-		void NapPlugin::registerParameters(const std::vector<nap::rtti::ObjectPtr<nap::Parameter>>& napParameters)
+		void NapPlugin::stagePreset(IParameterChanges* outputChanges, int32 sampleOffset)
 		{
-			auto paramID = kBypassId + 1;
-			for (auto& napParameter : napParameters)
+			// Audio thread: blend into the free buffer and hand it over, nothing is applied half way
+			auto& values = mStagedPresetValues.getWriteBuffer();
+			nap::PresetBank::morph(mPresetBank.getPreset(mPresetIndex), mPresetBank.getPreset(mMorphTargetIndex), mMorphAmount, values);
+
+			// The host learns the resulting values at the point the preset or morph changed
+			if (outputChanges != nullptr)
 			{
- 				Vst::TChar paramName[128];
+				for (auto i = 0; i < values.size(); ++i)
+				{
+					int32 queueIndex = 0;
+					int32 pointIndex = 0;
+					if (auto queue = outputChanges->addParameterData(kBypassId + 1 + i, queueIndex))
+						queue->addPoint(sampleOffset, values[i], pointIndex);
+				}
+			}
+			mStagedPresetValues.publish();
+		}
+
+
+		void NapPlugin::applyStagedPreset()
+		{
+			// Control thread
+			if (!mStagedPresetValues.update())
+				return;
 
- 				if (napParameter->get_type() == RTTI_OF(nap::ParameterFloat))
+			auto& values = mStagedPresetValues.getReadBuffer();
+			std::vector<float> normalizedValues(values.size());
+			for (auto i = 0; i < values.size(); ++i)
+			{
+				// Presets cover the parameters known at load time, later reloads only append
+				if (mParameters[i] == nullptr)
 				{
-     				mParameters.emplace_back(napParameter.get());
- 					auto napParameterFloat = rtti_cast<nap::ParameterFloat>(napParameter.get());
-					Steinberg::Vst::StringConvert::convert(napParameterFloat->getDisplayName(), paramName);
-					auto parameter = std::make_unique<Vst::RangeParameter>(paramName, paramID++, STR16(""), napParameterFloat->mMinimum, napParameterFloat->mMaximum, napParameterFloat->mValue);
-					parameters.addParameter(parameter.release());
+					normalizedValues[i] = values[i];
+					continue;
 				}
+				applyParameterValue(i, nap::denormalizeParameterValue(*mParameters[i], values[i]));
+				normalizedValues[i] = nap::normalizeParameterValue(*mParameters[i], mKnownValues[i]);
+			}
 
-				if (napParameter->get_type() == RTTI_OF(nap::ParameterInt))
+			// Keep the host side parameter values in sync
+			mMainThreadQueue.enqueue([this, normalizedValues]()
+			{
+				for (auto i = 0; i < normalizedValues.size(); ++i)
+					SingleComponentEffect::setParamNormalized(kBypassId + 1 + i, normalizedValues[i]);
+			});
+		}
+
+
+		void NapPlugin::registerPresets()
+		{
+			addUnit(new Unit(STR16("Root"), kRootUnitId, kNoParentUnitId, kPresetId));
+			mPresetList = new ProgramList(STR16("Presets"), kPresetId, kRootUnitId);
+			auto morphTarget = std::make_unique<Vst::StringListParameter>(STR16("Morph Target"), kMorphTargetId, STR16(""));
+			Vst::TChar presetName[128];
+			for (auto i = 0; i < mPresetBank.getCount(); ++i)
+			{
+				Steinberg::Vst::StringConvert::convert(mPresetBank.getPreset(i).mName, presetName);
+				mPresetList->addProgram(presetName);
+				morphTarget->appendString(presetName);
+			}
+			mHostPresetCount = mPresetBank.getCount();
+			addProgramList(mPresetList);
+			parameters.addParameter(mPresetList->getParameter());
+			mMorphTargetParameter = morphTarget.get();
+			parameters.addParameter(morphTarget.release());
+			parameters.addParameter(STR16("Morph"), nullptr, 0, 0, ParameterInfo::kCanAutomate, kMorphId);
+		}
+
+
+		bool NapPlugin::registerParameters(const std::vector<nap::rtti::ObjectPtr<nap::Parameter>>& napParameters, nap::utility::ErrorState& errorState)
+		{
+			for (auto& napParameter : napParameters)
+			{
+				auto parameter = createParameter(*napParameter, kBypassId + 1 + mParameters.size());
+				if (parameter != nullptr)
 				{
-     				mParameters.emplace_back(napParameter.get());
-					auto napParameterInt = rtti_cast<nap::ParameterInt>(napParameter.get());
-					Steinberg::Vst::StringConvert::convert(napParameterInt->getDisplayName(), paramName);
-					auto parameter = std::make_unique<Vst::RangeParameter>(paramName, paramID++, STR16(""), napParameterInt->mMinimum, napParameterInt->mMaximum, napParameterInt->mValue, 1.f);
+					if (!errorState.check(mParameters.size() < getMaxParameterCount(), "More than %d parameters, %s can't be registered", getMaxParameterCount(), napParameter->mID.c_str()))
+						return false;
+					mParameters.emplace_back(napParameter.get());
+					mParameterIDs.emplace_back(napParameter->mID);
 					parameters.addParameter(parameter.release());
 				}
+			}
+			return true;
+		}
+
+
+		std::unique_ptr<Vst::Parameter> NapPlugin::createParameter(nap::Parameter& napParameter, ParamID paramID)
+		{
+			Vst::TChar paramName[128];
+
+			if (napParameter.get_type() == RTTI_OF(nap::ParameterFloat))
+			{
+				auto napParameterFloat = rtti_cast<nap::ParameterFloat>(&napParameter);
+				Steinberg::Vst::StringConvert::convert(napParameterFloat->getDisplayName(), paramName);
+				return std::make_unique<Vst::RangeParameter>(paramName, paramID, STR16(""), napParameterFloat->mMinimum, napParameterFloat->mMaximum, napParameterFloat->mValue);
+			}
+
+			if (napParameter.get_type() == RTTI_OF(nap::ParameterInt))
+			{
+				auto napParameterInt = rtti_cast<nap::ParameterInt>(&napParameter);
+				Steinberg::Vst::StringConvert::convert(napParameterInt->getDisplayName(), paramName);
+				return std::make_unique<Vst::RangeParameter>(paramName, paramID, STR16(""), napParameterInt->mMinimum, napParameterInt->mMaximum, napParameterInt->mValue, 1.f);
+			}
+
+			if (napParameter.get_type() == RTTI_OF(nap::ParameterDropDown))
+			{
+				auto napParameterOptionList = rtti_cast<nap::ParameterDropDown>(&napParameter);
+				Steinberg::Vst::StringConvert::convert(napParameterOptionList->getDisplayName(), paramName);
+				auto parameter = std::make_unique<Vst::StringListParameter>(paramName, paramID, STR16(""));
+				Vst::TChar optionName[128];
+				for (auto& option : napParameterOptionList->mItems)
+				{
+					Steinberg::Vst::StringConvert::convert(option, optionName);
+					parameter->appendString(optionName);
+				}
+				return parameter;
+			}
+
+			return nullptr;
+		}
+
+
+		void NapPlugin::applyParameterValue(int index, float value)
+		{
+			// Control thread. Values from the host or a preset are known, so they aren't reported back as edits.
+			nap::setParameterValue(*mParameters[index], value);
+			mKnownValues[index] = nap::getParameterValue(*mParameters[index]);
+		}
+
+
+		void NapPlugin::syncKnownValues()
+		{
+			// Control thread, after the parameters were (re)bound
+			mKnownValues.resize(mParameters.size());
+			mEditorHeld.resize(mParameters.size(), false);
+			for (auto i = 0; i < mParameters.size(); ++i)
+				if (mParameters[i] != nullptr)
+					mKnownValues[i] = nap::getParameterValue(*mParameters[i]);
+		}
+
+
+		void NapPlugin::detectParameterEdits()
+		{
+			// Control thread, after the editor had its turn. Anything that differs from the known value was changed here.
+			for (auto i = 0; i < mParameters.size(); ++i)
+			{
+				if (mParameters[i] == nullptr)
+					continue;
+				auto value = nap::getParameterValue(*mParameters[i]);
+				if (value != mKnownValues[i])
+				{
+					mKnownValues[i] = value;
+					mEditorHeld[i] = mEditorGesture;
+					auto normalized = nap::normalizeParameterValue(*mParameters[i], value);
+					mParameterFeedback.write(i, normalized);
+					mProcessFeedback.write(i, normalized);
+				}
+				else if (!mEditorGesture)
+				{
+					mEditorHeld[i] = false;
+				}
+			}
+			mParameterFeedback.setGestureActive(mEditorGesture);
+		}
+
+
+		void NapPlugin::flushParameterEdits()
+		{
+			// Main thread. At most one performEdit per parameter per flush, however fast the editor changed it.
+			// Edits stay open while an editor item is held, so the host records a drag as one gesture.
+			if (componentHandler == nullptr)
+				return;
+
+			mParameterFeedback.read([this](int index, float value)
+			{
+				ParamID id = kBypassId + 1 + index;
+				if (index >= mHostEditing.size())
+					return;
+				if (!mHostEditing[index])
+				{
+					componentHandler->beginEdit(id);
+					mHostEditing[index] = true;
+					mHostEditCount++;
+				}
+				SingleComponentEffect::setParamNormalized(id, value);
+				componentHandler->performEdit(id, value);
+			});
+
+			if (mHostEditCount > 0 && !mParameterFeedback.isGestureActive())
+			{
+				for (auto i = 0; i < mHostEditing.size(); ++i)
+				{
+					if (!mHostEditing[i])
+						continue;
+					componentHandler->endEdit(kBypassId + 1 + i);
+					mHostEditing[i] = false;
+				}
+				mHostEditCount = 0;
+			}
+		}
+
+
+		void NapPlugin::writeParameterEdits(ProcessData& data)
+		{
+			// Audio thread, the editor's changes since the last block go out with this one as well
+			if (data.outputParameterChanges == nullptr)
+				return;
+
+			const ParamID firstId = kBypassId + 1;
+			mProcessFeedback.read([&data, firstId](int index, float value)
+			{
+				int32 queueIndex = 0;
+				int32 pointIndex = 0;
+				if (auto queue = data.outputParameterChanges->addParameterData(firstId + index, queueIndex))
+					queue->addPoint(0, value, pointIndex);
+			});
+		}
+
+
+		void NapPlugin::resourcesReloading()
+		{
+			// Control thread, inside Core::update right before changed resources are replaced.
+			// The swap doesn't wait for the fade, the output is silent as soon as the audio thread allows.
+			// Offline renders don't fade, the audio clock isn't running meanwhile.
+			if (mOfflineStepping)
+				return;
+			mOutputGainTarget = 0.f;
+			mReloadFade = EReloadFade::FadingOut;
+			mReloadFadeTicks = 0;
+		}
+
+
+		void NapPlugin::updateReloadFade()
+		{
+			// Control thread. The fade takes 10 ms, the tick limit covers an audio thread that stopped calling process().
+			if (mReloadFade != EReloadFade::FadingOut)
+				return;
+			if (mActive && mOutputGain.load() > 0.f && ++mReloadFadeTicks < maxReloadFadeTicks)
+				return;
+			mOutputGainTarget = 1.f;
+			mReloadFade = EReloadFade::Idle;
+		}
+
+
+		void NapPlugin::resourcesReloaded()
+		{
+			// Control thread, after a changed objects.json has been applied. Runs inside mCore->update with mMutex held,
+			// which main thread readers of mParameters (setState, getState) take as well.
+			// Host parameters stay bound to the NAP parameter with the same id. Parameters that disappeared stay registered but do nothing.
+			auto parameterGroup = mCore->getResourceManager()->findObject<nap::ParameterGroup>("Parameters").get();
+			mParameterGUI->mParameterGroup = parameterGroup;
+
+			std::unordered_map<std::string, nap::Parameter*> napParameters;
+			if (parameterGroup != nullptr)
+				for (auto& napParameter : parameterGroup->mMembers)
+					napParameters[napParameter->mID] = napParameter.get();
+
+			for (auto i = 0; i < mParameters.size(); ++i)
+			{
+				auto it = napParameters.find(mParameterIDs[i]);
+				mParameters[i] = it != napParameters.end() ? it->second : nullptr;
+				if (it != napParameters.end())
+					napParameters.erase(it);
+			}
 
-				if (napParameter->get_type() == RTTI_OF(nap::ParameterDropDown))
+			// New parameters are appended, so existing ids don't move
+			std::vector<Vst::Parameter*> newParameters;
+			std::vector<nap::Parameter*> newNapParameters;
+			if (parameterGroup != nullptr)
+			{
+				for (auto& napParameter : parameterGroup->mMembers)
 				{
-     				mParameters.emplace_back(napParameter.get());
-					auto napParameterOptionList = rtti_cast<nap::ParameterDropDown>(napParameter.get());
-					Steinberg::Vst::StringConvert::convert(napParameterOptionList->getDisplayName(), paramName);
-					auto parameter = std::make_unique<Vst::StringListParameter>(paramName, paramID++, STR16(""));
-					Vst::TChar optionName[128];
-					for (auto& option : napParameterOptionList->mItems)
+					if (napParameters.find(napParameter->mID) == napParameters.end())
+						continue;
+					auto parameter = createParameter(*napParameter, kBypassId + 1 + mParameters.size() + newParameters.size());
+					if (parameter != nullptr)
 					{
-						Steinberg::Vst::StringConvert::convert(option, optionName);
-						parameter->appendString(optionName);
+						newParameters.emplace_back(parameter.release());
+						newNapParameters.emplace_back(napParameter.get());
 					}
-					parameters.addParameter(parameter.release());
 				}
 			}
+
+			// Ids past the reserved range would collide with the preset and MIDI controller ids
+			if (mParameters.size() + newParameters.size() > getMaxParameterCount())
+			{
+				nap::Logger::error("Reload adds %d parameters, more than the %d the plugin can expose. New parameters are not registered.",
+					int(newParameters.size()), getMaxParameterCount());
+				for (auto parameter : newParameters)
+					delete parameter;
+				newParameters.clear();
+				newNapParameters.clear();
+			}
+			for (auto napParameter : newNapParameters)
+			{
+				mParameters.emplace_back(napParameter);
+				mParameterIDs.emplace_back(napParameter->mID);
+			}
+
+			mParameterFeedback.grow(mParameters.size());
+			mProcessFeedback.grow(mParameters.size());
+			if (!newParameters.empty())
+				mMainThreadQueue.enqueue([this, newParameters, parameterCount = mParameters.size()]()
+				{
+					mHostEditing.resize(parameterCount, false);
+					for (auto parameter : newParameters)
+						parameters.addParameter(parameter);
+					if (componentHandler != nullptr)
+						componentHandler->restartComponent(kParamTitlesChanged);
+				});
+
+			syncKnownValues();
+			mMidiRouter.build(getMidiFilters());
+
+			// The synth was rebuilt without voices, possibly with a different voice count
+			configureVoicePool();
+			mVoicePool.requestReset();
+			nap::Logger::info("Reloaded resources, %d parameters, %d new", int(mParameters.size()), int(newParameters.size()));
+		}
+
+
+		void NapPlugin::applyOutputFade(float** outputs, int numSamples)
+		{
+			// Audio thread, short linear fade around resource reloads
+			float target = mOutputGainTarget.load();
+			float gain = mOutputGain.load();
+			if (gain == target && gain == 1.f)
+				return;
+
+			// The ramp is worked out once per stretch, then applied to every channel
+			const float step = 1.f / (0.01f * mSampleRate);
+			const int channelCount = mAudioService->getNodeManager().getOutputChannelCount();
+			constexpr int stretchSize = 64;
+			float gains[stretchSize];
+			for (auto start = 0; start < numSamples; start += stretchSize)
+			{
+				const int count = std::min(stretchSize, numSamples - start);
+				for (auto i = 0; i < count; ++i)
+				{
+					gain = gain < target ? std::min(gain + step, target) : std::max(gain - step, target);
+					gains[i] = gain;
+				}
+				for (auto channel = 0; channel < channelCount; ++channel)
+					nap::simd::multiply(outputs[channel] + start, gains, count);
+			}
+			mOutputGain = gain;
 		}
 
 
@@ -515,5 +1900,7 @@ BEGIN_FACTORY_DEF (stringCompanyName, stringCompanyWeb, stringCompanyEmail)
 				Steinberg::Vst::NapPlugin::createInstance)// function pointer called when this component should be instantiated
 END_FACTORY
 
+#ifdef NAPVST_WITH_EDITOR
 static ModuleInitializer gVSTGUIInit([]{ VSTGUI::init(getPlatformModuleHandle()); });
 static ModuleTerminator gVSTGUITerm([]{ VSTGUI::exit(); });
+#endif
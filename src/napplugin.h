@@ -5,6 +5,8 @@
 #include "public.sdk/source/vst/vstsinglecomponenteffect.h"
 
 #include "pluginterfaces/vst/ivstcontextmenu.h"
+#include "pluginterfaces/gui/iplugview.h"
+#include "pluginterfaces/vst/ivstmidicontrollers.h"
 
 #include <audio/service/audioservice.h>
 #include <ControlThread.h>
@@ -17,8 +19,22 @@
 #include <parametergui.h>
 #include <renderwindow.h>
 
+#include "analysistap.h"
+#include "arena.h"
+#include "audioworker.h"
+#include "cpugovernor.h"
+#include "midirouter.h"
+#include "offlinestepper.h"
+#include "oversampler.h"
+#include "parameterfeedback.h"
+#include "presetbank.h"
 #include "sdlpoller.h"
+#include "telemetry.h"
+#include "triplebuffer.h"
+#include "voicepool.h"
+#ifdef NAPVST_WITH_EDITOR
 #include "nappluginview.h"
+#endif
 #include "sdleventconverter.h"
 #include "base/source/timer.h"
 
@@ -29,7 +45,9 @@ namespace Vst {
 template <typename T>
 class AGainUIMessageController;
 
-class NapPlugin : public SingleComponentEffect, ITimerCallback
+class NapPluginView;
+
+class NapPlugin : public SingleComponentEffect, public IMidiMapping, ITimerCallback
 {
 public:
 	//------------------------------------------------------------------------
@@ -45,6 +63,7 @@ public:
 	tresult PLUGIN_API setActive (TBool state) SMTG_OVERRIDE;
 	tresult PLUGIN_API process (ProcessData& data) SMTG_OVERRIDE;
 	tresult PLUGIN_API canProcessSampleSize (int32 symbolicSampleSize) SMTG_OVERRIDE;
+	uint32 PLUGIN_API getLatencySamples () SMTG_OVERRIDE;
 	tresult PLUGIN_API setState (IBStream* state) SMTG_OVERRIDE;
 	tresult PLUGIN_API getState (IBStream* state) SMTG_OVERRIDE;
 	tresult PLUGIN_API setupProcessing (ProcessSetup& newSetup) SMTG_OVERRIDE;
@@ -57,12 +76,17 @@ public:
 	tresult PLUGIN_API setEditorState (IBStream* state) SMTG_OVERRIDE;
 	tresult PLUGIN_API getEditorState (IBStream* state) SMTG_OVERRIDE;
 	tresult PLUGIN_API setParamNormalized (ParamID tag, ParamValue value) SMTG_OVERRIDE;
+	ParamValue PLUGIN_API getParamNormalized (ParamID tag) SMTG_OVERRIDE;
 	tresult PLUGIN_API getParamStringByValue (ParamID tag, ParamValue valueNormalized,
 	                                          String128 string) SMTG_OVERRIDE;
 	tresult PLUGIN_API getParamValueByString (ParamID tag, TChar* string,
 	                                          ParamValue& valueNormalized) SMTG_OVERRIDE;
 	void onTimer(Timer* timer) SMTG_OVERRIDE;
 
+	//---from IMidiMapping---------
+	tresult PLUGIN_API getMidiControllerAssignment (int32 busIndex, int16 channel, CtrlNumber midiControllerNumber,
+	                                                ParamID& id) SMTG_OVERRIDE;
+
 	//---Interface---------
 	OBJ_METHODS (NapPlugin, SingleComponentEffect)
 	tresult PLUGIN_API queryInterface (const TUID iid, void** obj) SMTG_OVERRIDE;
@@ -73,7 +97,7 @@ public:
 	nap::ControlThread& getControlThread() { return mControlThread; }
 	std::mutex& getMutex() { return mMutex; }
 
-	void viewClosed() { mView = nullptr; }
+	void viewClosed();
 
 	// Input bridging (VSTGUI -> NAP)
 	void processNAPInputEvent(const nap::InputEvent& ev);
@@ -82,11 +106,74 @@ public:
 
 private:
 	bool initializeNAP(nap::TaskQueue& mainThreadQueue, nap::utility::ErrorState& errorState);
-	void registerParameters(const std::vector<nap::rtti::ObjectPtr<nap::Parameter>>& napParameters);
+	bool registerParameters(const std::vector<nap::rtti::ObjectPtr<nap::Parameter>>& napParameters, nap::utility::ErrorState& errorState);
+	int getMaxParameterCount() const { return kPresetId - kBypassId - 1; }	// NAP parameter ids stay below kPresetId
+	std::unique_ptr<Vst::Parameter> createParameter(nap::Parameter& napParameter, ParamID paramID);
+	void registerPresets();
+	void stagePreset(IParameterChanges* outputChanges, int32 sampleOffset);
+	void applyStagedPreset();
+	void renderAudio(float** inputs, float** outputs, int numSamples);
+	void renderWorkerAudio(float** inputs, float** outputs, int numSamples);	// renderAudio on the worker thread, timed for the governor
+	void renderGraph(float** inputs, float** outputs, int numSamples);
+	int getOversamplingFactor() const;
+	std::vector<bool> getIntegralLayout() const;	// Which parameters are stored as int32 in the state chunk, takes mMutex being held
 
 	int kBypassId = 0;
+	int kPresetId = 1000;		// Program change, also the program list id
+	int kMorphTargetId = 1001;
+	int kMorphId = 1002;
+	int kOutputPeakId = 1003;	// Read only meters
+	int kOutputRMSId = 1004;
+	int kMidiControllerId = 2000;	// Hidden, one per channel and controller, see getMidiControllerAssignment
+	static constexpr int midiControllerCount = kPitchBend + 1;	// CCs, channel pressure and pitch bend
 	bool mBypass = false;
 	int mProcessingMode;
+	double mSampleRate = 44100.0;
+	int mMaxSamplesPerBlock = 0;
+
+	// Host buses map onto consecutive NAP channels: main bus first, then the stem buses.
+	// Worked out in setActive, process() only collects the host's channel pointers.
+	static bool isSupportedArrangement(SpeakerArrangement arrangement);
+	void prepareRouting();
+	float** gatherChannels(AudioBusBuffers* buses, int32 busCount, const std::vector<int>& busChannelCounts, std::vector<float*>& pointers, float* missing);
+	std::vector<int> mInputBusChannels;
+	std::vector<int> mOutputBusChannels;
+	std::vector<float*> mInputPointers;
+	std::vector<float*> mOutputPointers;
+	float* mSilence = nullptr;		// Stands in for input channels the host leaves out
+	float* mDiscard = nullptr;		// Receives output for channels the host leaves out
+
+	// Per instance memory for all audio buffers of the current activation, released as a whole on deactivation
+	nap::Arena mScratchMemory;
+
+	// Runs the graph at a multiple of the host rate, the factor depends on the processing mode
+	nap::Oversampler mOversampler = { [this](float** inputs, float** outputs, int numSamples){ renderGraph(inputs, outputs, numSamples); } };
+	std::atomic<int> mRealtimeOversampling = { 2 };
+	std::atomic<int> mOfflineOversampling = { 8 };
+	std::atomic<bool> mGovernorRestart = { false };		// The governor asked for the pending reactivation, its level is kept
+
+	// Sheds quality under sustained realtime overload
+	nap::CPUGovernor mGovernor;
+	nap::CPUGovernor::ELevel mLoggedGovernorLevel = nap::CPUGovernor::ELevel::Full;
+	uint64_t mControlTick = 0;
+
+	// Timing counters, shared with external tools through a mapped file
+	nap::Telemetry mTelemetry;
+
+	// Presets are blended on the audio thread at a block boundary and applied in one go on the control thread
+	nap::PresetBank mPresetBank;
+	ProgramList* mPresetList = nullptr;
+	StringListParameter* mMorphTargetParameter = nullptr;
+	std::atomic<int> mHostPresetCount = { 0 };		// Entries in the program list as last announced to the host
+	std::atomic<int> mPresetIndex = { 0 };			// Written by the audio thread and by setState
+	std::atomic<int> mMorphTargetIndex = { 0 };
+	std::atomic<float> mMorphAmount = { 0.f };
+	nap::TripleBuffer<std::vector<float>> mStagedPresetValues;
+	char mPresetName[64] = "";
+
+	// Renders the graph on a worker thread one block behind the host, not used when rendering offline
+	nap::AudioWorker mAudioWorker = { [this](float** inputs, float** outputs, int numSamples){ renderWorkerAudio(inputs, outputs, numSamples); } };
+	bool mUseAudioWorker = false;
 
 	std::unique_ptr<nap::Core> mCore = nullptr;
 	nap::Core::ServicesHandle mServices;
@@ -96,8 +183,26 @@ private:
 	nap::InputService* mInputService = nullptr;
 	nap::SDLInputService* mSDLInputService = nullptr;
 	nap::IMGuiService* mGuiService = nullptr;
-	std::vector<nap::Parameter*> mParameters;
+	std::vector<nap::Parameter*> mParameters;		// Indexed by host parameter id - 1, null when removed by a reload
+	std::vector<std::string> mParameterIDs;			// NAP ids the host parameters are bound to
+
+	// Editor changes are reported to the host as edits and as output parameter changes,
+	// see detectParameterEdits(), flushParameterEdits() and writeParameterEdits()
+	void applyParameterValue(int index, float value);
+	void syncKnownValues();
+	void detectParameterEdits();
+	void flushParameterEdits();
+	void writeParameterEdits(ProcessData& data);
+	nap::ParameterFeedback mParameterFeedback;		// Control thread to main thread, as host edits
+	nap::ParameterFeedback mProcessFeedback;		// Control thread to audio thread, as output parameter changes
+	std::vector<float> mKnownValues;		// Control thread, last value set or reported per parameter
+	std::vector<bool> mEditorHeld;			// Control thread, changed during the current editor gesture
+	bool mEditorGesture = false;			// Control thread, an editor item is being dragged or pressed
+	std::vector<bool> mHostEditing;			// Main thread, between beginEdit and endEdit
+	int mHostEditCount = 0;
+	static constexpr double controlRate = 60.0;	// Ticks per second of the control thread and the host timer
 	nap::ControlThread mControlThread;
+	nap::TaskQueue mControlQueue;		// Run at the start of every control tick, with mMutex held
 	nap::TaskQueue mMainThreadQueue;
 
 	std::unique_ptr<nap::ParameterGUI> mParameterGUI = nullptr;
@@ -108,10 +213,117 @@ private:
 
 	nap::Slot<double> mControlSlot = { this, &NapPlugin::control };
 	void control(double deltaTime);
+	void showOversamplingGUI();
+	void showGovernorGUI();
+	void showTelemetryGUI();
+	void showPresetGUI();
+	void showAnalysisGUI();
+	void showVoiceGUI();
+	void enqueueMidiEvent(nap::MidiRouter::EType type, int channel, int number, int value);
+	void handleControllerChange(int controllerIndex, float value);
+	std::vector<nap::MidiRouter::Filter> getMidiFilters();
+	void dispatchMidiEvents();
+	nap::MidiRouter mMidiRouter;
+	std::array<int, nap::MidiRouter::channelCount * midiControllerCount> mControllerValues;	// Audio thread, last value sent per controller
+	nap::VoicePool mVoicePool;		// Audio thread, settings from any thread
+	nap::Parameter* mReleaseParameter = nullptr;
+	int mVoiceCount = 16;			// Voices of the synth's Polyphonic object
+	void handleNoteEvent(const Vst::Event& e);
+
+	// Note events and mapped controller points of one block, handed on merged by sample offset.
+	// The host sorts the events and the points of every queue, so the queues' heads are merged with the events.
+	struct ControllerPoint
+	{
+		int32 mSampleOffset;
+		int mIndex;
+		float mValue;
+	};
+	struct ControllerQueue
+	{
+		int mNext;		// Into mControllerPoints
+		int mEnd;
+	};
+	static constexpr int maxControllerPoints = 1024;		// Per block, later points are dropped
+	void beginMidiInput(IEventList* events);
+	int getNextMidiInputOffset();		// -1 when the block has no more input
+	void handleNextMidiInput();
+	std::vector<ControllerPoint> mControllerPoints;		// Audio thread, reserved to maxControllerPoints up front
+	std::vector<ControllerQueue> mControllerQueues;		// Audio thread, reserved to one per controller
+	int mNextControllerQueue = -1;						// Set by getNextMidiInputOffset when a controller point goes first
+	IEventList* mInputEvents = nullptr;
+	int32 mInputEventCount = 0;
+	int32 mInputEventIndex = 0;
+	Vst::Event mInputEvent;
+	void configureVoicePool();
+	void updateVoiceRelease();
+
+	// Offline renders run the control logic from process(), on the audio clock
+	static constexpr int offlineControlInterval = 128;	// Samples between mCore->update calls
+	tresult processOffline(ProcessData& data);
+	void renderOffline(int offset, int numSamples);
+	void stepControl();
+	void enqueueControlTask(std::function<void()> task);
+	std::atomic<bool> mOfflineStepping = { false };
+	nap::OfflineStepper mOfflineStepper = { {
+		[this](){ return getNextMidiInputOffset(); },
+		[this](){ handleNextMidiInput(); },
+		[this](double){ stepControl(); },
+		[this](int offset, int numSamples){ renderOffline(offset, numSamples); } } };
+	float** mOfflineInputs = nullptr;
+	float** mOfflineOutputs = nullptr;
+	std::vector<float*> mOfflineInputPointers;
+	std::vector<float*> mOfflineOutputPointers;
+	void writeMeters(ProcessData& data);
+	nap::AnalysisTap mAnalysisTap;
+	float mPeakHold = 0.f;		// Editor meter ballistics, control thread
+	float mRMSHold = 0.f;
+	nap::RenderWindow* getEditorWindow();	// Null when the editor is closed or not compiled in
+
+	// Offscreen editor, see createOffscreenEditor()
+	void createOffscreenEditor();
+	SDL_Window* mOffscreenWindow = nullptr;
+	std::unique_ptr<nap::RenderWindow> mOffscreenRenderWindow = nullptr;
+	FILE* mFrameDump = nullptr;
+
+	// Hot reload of objects.json
+	nap::Slot<> mResourcesReloadingSlot = { this, &NapPlugin::resourcesReloading };
+	nap::Slot<> mResourcesReloadedSlot = { this, &NapPlugin::resourcesReloaded };
+	void resourcesReloading();
+	void resourcesReloaded();
+
+	// NAP's file watcher reloads changed resources during Core::update. The output fades out when that starts
+	// and fades back in once it reached silence, a few ticks later at most.
+	enum class EReloadFade { Idle, FadingOut };
+	static constexpr int maxReloadFadeTicks = 6;
+	void updateReloadFade();
+	EReloadFade mReloadFade = EReloadFade::Idle;
+	int mReloadFadeTicks = 0;
+	void applyOutputFade(float** outputs, int numSamples);
+	std::atomic<float> mOutputGainTarget = { 1.f };
+	std::atomic<float> mOutputGain = { 1.f };
 	std::mutex mMutex; // Main mutex guarding control and main thread
 
 	nap::SDLPoller::Client mSDLPollerClient;
 	bool mInitialized = false;
+
+	// Deactivated instances park the control loop and free their audio buffers, see setActive()
+	void updateSuspension();
+	std::atomic<bool> mActive = { false };
+	bool mSuspended = true;
+	bool mHostTimer = false;		// False when the host has no run loop for our timer
+
+	// Main thread tasks call back into the host, so they only run on the thread the host calls us from.
+	// The timer is the SDK's or, on Linux, one registered with the host's run loop. Without either,
+	// pending tasks run whenever the host calls one of our main thread methods.
+	bool startMainThreadTimer();
+	void stopMainThreadTimer();
+	void processMainThread();
+	bool mProcessingMainThread = false;
+#if SMTG_OS_LINUX
+	IPtr<Linux::IRunLoop> mRunLoop;
+	IPtr<Linux::ITimerHandler> mRunLoopTimer;
+	bool mRunLoopTimerRegistered = false;
+#endif
 	NapPluginView* mView = nullptr;
 };
 
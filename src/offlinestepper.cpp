@@ -0,0 +1,68 @@
+#include "offlinestepper.h"
+
+#include <algorithm>
+
+namespace nap
+{
+
+	void OfflineStepper::reset(int interval, double sampleRate)
+	{
+		mInterval = std::max(interval, 1);
+		mSampleRate = sampleRate;
+		mSamplesUntilStep = 0;
+		mSamplesSinceStep = 0;
+		mHash = 2166136261u;
+		mSampleCount = 0;
+	}
+
+
+	void OfflineStepper::process(int numSamples)
+	{
+		int position = 0;
+		while (true)
+		{
+			// Events due now are handled before the step that hands them to the synth.
+			// Offsets past the block are clamped to its end.
+			bool eventsHandled = false;
+			int offset = mCallbacks.mNextEventOffset();
+			while (offset >= 0 && (offset <= position || position == numSamples))
+			{
+				mCallbacks.mHandleEvent();
+				eventsHandled = true;
+				offset = mCallbacks.mNextEventOffset();
+			}
+			if (eventsHandled || mSamplesUntilStep == 0)
+			{
+				mCallbacks.mStep(mSamplesSinceStep / mSampleRate);
+				mSamplesUntilStep = mInterval;
+				mSamplesSinceStep = 0;
+			}
+			if (position == numSamples)
+				break;
+
+			int end = std::min(numSamples, position + mSamplesUntilStep);
+			if (offset >= 0)
+				end = std::min(end, std::max(offset, position + 1));
+			mCallbacks.mRender(position, end - position);
+			mSamplesUntilStep -= end - position;
+			mSamplesSinceStep += end - position;
+			position = end;
+		}
+	}
+
+
+	void OfflineStepper::hash(const float* const* channels, int channelCount, int numSamples)
+	{
+		for (auto channel = 0; channel < channelCount; ++channel)
+		{
+			auto bytes = reinterpret_cast<const uint8_t*>(channels[channel]);
+			for (auto i = 0; i < numSamples * sizeof(float); ++i)
+			{
+				mHash ^= bytes[i];
+				mHash *= 16777619u;
+			}
+		}
+		mSampleCount += numSamples;
+	}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+
+namespace nap
+{
+
+	// Drives the control logic from the audio clock during offline renders.
+	// A block is split into stretches of audio: a control step runs every interval samples and right before
+	// a note event is due, so events reach the synth at their sample offset. Each step is passed the audio time
+	// since the previous one. The same events in the same blocks give the same steps, however fast the host calls.
+	class OfflineStepper
+	{
+	public:
+		struct Callbacks
+		{
+			std::function<int()> mNextEventOffset;					// Sample offset of the next pending event, -1 when there is none
+			std::function<void()> mHandleEvent;						// Handles the pending event and moves on to the next one
+			std::function<void(double deltaTime)> mStep;			// Runs the control logic
+			std::function<void(int offset, int numSamples)> mRender;	// Renders a stretch of the block
+		};
+
+		OfflineStepper(Callbacks callbacks) : mCallbacks(std::move(callbacks)) { }
+
+		// Starts a render, the first block begins with a step
+		void reset(int interval, double sampleRate);
+
+		void process(int numSamples);
+
+		// FNV-1a over every rendered sample, to compare renders
+		void hash(const float* const* channels, int channelCount, int numSamples);
+		uint32_t getHash() const { return mHash; }
+		uint64_t getSampleCount() const { return mSampleCount; }
+
+	private:
+		Callbacks mCallbacks;
+		int mInterval = 128;
+		double mSampleRate = 44100.0;
+		int mSamplesUntilStep = 0;
+		int mSamplesSinceStep = 0;
+		uint32_t mHash = 2166136261u;
+		uint64_t mSampleCount = 0;
+	};
+
+}
@@ -0,0 +1,270 @@
+#include "oversampler.h"
+#include "vectorkernels.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace nap
+{
+
+	// Filter length per stage, later stages run at higher rates and can afford a wider transition band
+	static constexpr int stageTapCounts[] = { 47, 23, 11 };
+	static constexpr int maxStageCount = 3;
+
+
+	static double besselI0(double x)
+	{
+		double sum = 1.0;
+		double term = 1.0;
+		for (auto k = 1; k < 32; ++k)
+		{
+			term *= (x / (2.0 * k)) * (x / (2.0 * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+
+	static std::vector<float> computeTaps(int tapCount)
+	{
+		assert((tapCount - 3) % 4 == 0);
+		const int center = (tapCount - 3) / 2 + 1;
+
+		// Kaiser windowed sinc with its cutoff at a quarter of the sample rate.
+		// Every other tap of a half-band filter is zero, only the even indexed ones are kept.
+		const double beta = 8.0;
+		std::vector<float> taps;
+		double sum = 0.0;
+		for (auto k = 0; k < tapCount; k += 2)
+		{
+			double x = 0.5 * (k - center);
+			double sinc = std::sin(M_PI * x) / (M_PI * x);
+			double r = double(k - center) / center;
+			double window = besselI0(beta * std::sqrt(1.0 - r * r)) / besselI0(beta);
+			double tap = 0.5 * sinc * window;
+			taps.emplace_back(tap);
+			sum += tap;
+		}
+
+		// The center tap contributes 0.5, normalize the rest for unity gain at DC
+		for (auto& tap : taps)
+			tap *= 0.5 / sum;
+		return taps;
+	}
+
+
+	void HalfBandFilter::init(int tapCount, int maxInputSize, Arena& arena)
+	{
+		mCenterDelay = (tapCount - 3) / 4;
+		mTaps = computeTaps(tapCount);
+
+		mBuffer = arena.allocateFloats(mTaps.size() - 1 + maxInputSize);
+		mCenterBuffer = arena.allocateFloats(mCenterDelay + 1 + maxInputSize);
+		mAccumulator = arena.allocateFloats(maxInputSize);
+	}
+
+
+	void HalfBandFilter::interpolate(const float* input, float* output, int numSamples)
+	{
+		const int history = mTaps.size() - 1;
+		float* buffer = mBuffer + history;
+		float* accumulator = mAccumulator;
+		std::copy(input, input + numSamples, buffer);
+
+		std::fill(accumulator, accumulator + numSamples, 0.f);
+		for (auto j = 0; j < mTaps.size(); ++j)
+			simd::multiplyAccumulate(accumulator, buffer - j, 2.f * mTaps[j], numSamples);
+
+		// Odd outputs only see the center tap, which reduces to a plain delay
+		const float* delayed = buffer - mCenterDelay;
+		for (auto i = 0; i < numSamples; ++i)
+		{
+			output[2 * i] = accumulator[i];
+			output[2 * i + 1] = delayed[i];
+		}
+
+		std::copy(mBuffer + numSamples, mBuffer + numSamples + history, mBuffer);
+	}
+
+
+	void HalfBandFilter::decimate(const float* input, float* output, int numSamples)
+	{
+		const int history = mTaps.size() - 1;
+		const int centerHistory = mCenterDelay + 1;
+		float* buffer = mBuffer + history;
+		float* centerBuffer = mCenterBuffer + centerHistory;
+		float* accumulator = mAccumulator;
+		for (auto i = 0; i < numSamples; ++i)
+		{
+			buffer[i] = input[2 * i];
+			centerBuffer[i] = input[2 * i + 1];
+		}
+
+		std::fill(accumulator, accumulator + numSamples, 0.f);
+		for (auto j = 0; j < mTaps.size(); ++j)
+			simd::multiplyAccumulate(accumulator, buffer - j, mTaps[j], numSamples);
+
+		const float* delayed = centerBuffer - centerHistory;
+		for (auto i = 0; i < numSamples; ++i)
+			output[i] = accumulator[i] + 0.5f * delayed[i];
+
+		std::copy(mBuffer + numSamples, mBuffer + numSamples + history, mBuffer);
+		std::copy(mCenterBuffer + numSamples, mCenterBuffer + numSamples + centerHistory, mCenterBuffer);
+	}
+
+
+	static int getStageCount(int factor)
+	{
+		int stageCount = 0;
+		while ((1 << stageCount) < factor && stageCount < maxStageCount)
+			stageCount++;
+		return stageCount;
+	}
+
+
+	static int getStageLatency(int stageCount)
+	{
+		// Each stage delays by its filter's group delay at the stage's lower rate.
+		// Counted in samples at the rate of the last stage, where the sum is a whole number.
+		int latency = 0;
+		for (auto s = 0; s < stageCount; ++s)
+		{
+			const int center = (stageTapCounts[s] - 1) / 2;
+			latency += center << (stageCount - s);
+		}
+		return latency;
+	}
+
+
+	static int getRoundedLatency(int stageCount)
+	{
+		const int rate = 1 << stageCount;
+		return (getStageLatency(stageCount) + rate - 1) / rate;
+	}
+
+
+	static int getPadding(int stageCount)
+	{
+		// Delay at the oversampled rate that rounds the group delay up to whole host samples
+		return (getRoundedLatency(stageCount) << stageCount) - getStageLatency(stageCount);
+	}
+
+
+	void Oversampler::prepare(int inputChannelCount, int outputChannelCount, int maxBlockSize, int factor, Arena& arena)
+	{
+		mStageCount = getStageCount(factor);
+
+		mInputChannelCount = inputChannelCount;
+		mOutputChannelCount = outputChannelCount;
+		mStages.resize(mStageCount);
+		for (auto s = 0; s < mStageCount; ++s)
+		{
+			auto& stage = mStages[s];
+			const int stageBlockSize = maxBlockSize << s;
+			stage.mUpFilters.resize(inputChannelCount);
+			for (auto& filter : stage.mUpFilters)
+				filter.init(stageTapCounts[s], stageBlockSize, arena);
+			stage.mDownFilters.resize(outputChannelCount);
+			for (auto& filter : stage.mDownFilters)
+				filter.init(stageTapCounts[s], stageBlockSize, arena);
+
+			// Channels of one stage sit next to each other
+			stage.mSize = 2 * stageBlockSize;
+			stage.mInputs.resize(inputChannelCount);
+			for (auto& channel : stage.mInputs)
+				channel = arena.allocateFloats(stage.mSize);
+			stage.mOutputs.resize(outputChannelCount);
+			for (auto& channel : stage.mOutputs)
+				channel = arena.allocateFloats(stage.mSize);
+		}
+
+		mPaddingDelay = getPadding(mStageCount);
+		mPadding.resize(outputChannelCount);
+		for (auto& channel : mPadding)
+			channel = arena.allocateFloats(std::max(mPaddingDelay, 1));
+		mPaddingPosition = 0;
+	}
+
+
+	void Oversampler::release()
+	{
+		mStages.clear();
+		mPadding.clear();
+		mStageCount = 0;
+		mPaddingDelay = 0;
+		mPaddingPosition = 0;
+	}
+
+
+	void Oversampler::process(float** inputs, float** outputs, int numSamples)
+	{
+		if (mStageCount == 0)
+			mRenderFunction(inputs, outputs, numSamples);
+		else
+			processStages(inputs, outputs, numSamples);
+	}
+
+
+	int Oversampler::applyDelay(std::vector<float*>& lines, int delay, int position, float** channels, int numSamples)
+	{
+		if (delay == 0)
+			return 0;
+
+		for (auto channel = 0; channel < lines.size(); ++channel)
+		{
+			float* line = lines[channel];
+			auto linePosition = position;
+			for (auto i = 0; i < numSamples; ++i)
+			{
+				std::swap(channels[channel][i], line[linePosition]);
+				if (++linePosition == delay)
+					linePosition = 0;
+			}
+		}
+		return (position + numSamples) % delay;
+	}
+
+
+	void Oversampler::processStages(float** inputs, float** outputs, int numSamples)
+	{
+		auto& lastStage = mStages[mStageCount - 1];
+		if (inputs != nullptr)
+		{
+			for (auto s = 0; s < mStageCount; ++s)
+			{
+				auto& stage = mStages[s];
+				for (auto channel = 0; channel < mInputChannelCount; ++channel)
+				{
+					const float* source = s == 0 ? inputs[channel] : mStages[s - 1].mInputs[channel];
+					stage.mUpFilters[channel].interpolate(source, stage.mInputs[channel], numSamples << s);
+				}
+			}
+		}
+		else
+		{
+			for (auto channel : lastStage.mInputs)
+				std::fill(channel, channel + lastStage.mSize, 0.f);
+		}
+
+		mRenderFunction(lastStage.mInputs.data(), lastStage.mOutputs.data(), numSamples << mStageCount);
+		mPaddingPosition = applyDelay(mPadding, mPaddingDelay, mPaddingPosition, lastStage.mOutputs.data(), numSamples << mStageCount);
+
+		for (auto s = mStageCount - 1; s >= 0; --s)
+		{
+			auto& stage = mStages[s];
+			for (auto channel = 0; channel < mOutputChannelCount; ++channel)
+			{
+				float* destination = s == 0 ? outputs[channel] : mStages[s - 1].mOutputs[channel];
+				stage.mDownFilters[channel].decimate(stage.mOutputs[channel], destination, numSamples << s);
+			}
+		}
+	}
+
+
+	int Oversampler::getLatencySamples(int factor)
+	{
+		return getRoundedLatency(getStageCount(factor));
+	}
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "arena.h"
+
+#include <functional>
+#include <vector>
+
+
+namespace nap
+{
+
+	// Linear phase half-band FIR that interpolates or decimates by two.
+	// Only the non-zero taps are evaluated, split into their two polyphase branches.
+	// Loops run over samples per tap so they vectorize without reassociating the sums, see vectorkernels.h.
+	class HalfBandFilter
+	{
+	public:
+		// tapCount has to be of the form 4m + 3, buffers are taken from the arena
+		void init(int tapCount, int maxInputSize, Arena& arena);
+
+		// Writes 2 * numSamples samples to output
+		void interpolate(const float* input, float* output, int numSamples);
+
+		// Reads 2 * numSamples samples from input
+		void decimate(const float* input, float* output, int numSamples);
+
+	private:
+		std::vector<float> mTaps;			// Even indexed coefficients
+		int mCenterDelay = 0;				// m, the center tap sits at 2m + 1
+		float* mBuffer = nullptr;			// Branch history followed by the current block
+		float* mCenterBuffer = nullptr;		// Center tap history followed by the current block
+		float* mAccumulator = nullptr;
+	};
+
+
+	// Runs a render function at 1, 2, 4 or 8 times the host rate, with cascaded half-band stages on either side.
+	// All buffers are taken from the arena passed to prepare(), they live as long as the arena's memory.
+	class Oversampler
+	{
+	public:
+		using RenderFunction = std::function<void(float** inputs, float** outputs, int numSamples)>;
+
+		Oversampler(RenderFunction renderFunction) : mRenderFunction(std::move(renderFunction)) { }
+
+		void prepare(int inputChannelCount, int outputChannelCount, int maxBlockSize, int factor, Arena& arena);
+
+		// Drops all buffers before the arena releases them, prepare() has to be called again before processing
+		void release();
+		void process(float** inputs, float** outputs, int numSamples);
+
+		// The factor only changes through another prepare(), which happens on reactivation
+		int getPreparedFactor() const { return 1 << mStageCount; }
+
+		// Round trip delay through all stages in host rate samples.
+		// The filters' group delay is a fraction of a host sample at 4x and 8x, it is padded up to the next whole sample.
+		static int getLatencySamples(int factor);
+
+	private:
+		void processStages(float** inputs, float** outputs, int numSamples);
+
+		// Delays channels by a ring of delay samples per channel, returns the new ring position
+		static int applyDelay(std::vector<float*>& lines, int delay, int position, float** channels, int numSamples);
+
+		struct Stage
+		{
+			std::vector<HalfBandFilter> mUpFilters;
+			std::vector<HalfBandFilter> mDownFilters;
+			std::vector<float*> mInputs;	// Upsampled input at this stage's rate
+			std::vector<float*> mOutputs;	// Rendered output at this stage's rate
+			int mSize = 0;					// Samples per channel buffer
+		};
+
+		RenderFunction mRenderFunction;
+		std::vector<Stage> mStages;
+		int mStageCount = 0;
+		int mInputChannelCount = 0;
+		int mOutputChannelCount = 0;
+
+		// Rounds the stages' group delay up to whole host samples, runs at the oversampled rate
+		std::vector<float*> mPadding;
+		int mPaddingDelay = 0;
+		int mPaddingPosition = 0;
+	};
+
+}
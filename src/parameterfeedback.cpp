@@ -0,0 +1,64 @@
+#include "parameterfeedback.h"
+
+#include <algorithm>
+
+
+namespace nap
+{
+
+	void ParameterFeedback::init(int capacity, int maxCapacity)
+	{
+		mMaxCapacity = maxCapacity;
+		mStorage.clear();
+		mBlocks = std::make_unique<std::atomic<Block*>[]>((maxCapacity + blockSize - 1) / blockSize);
+		mCapacity = 0;
+		mUsedCount = 0;
+		mPending = false;
+		mGestureActive = false;
+		grow(capacity);
+	}
+
+
+	void ParameterFeedback::grow(int capacity)
+	{
+		capacity = std::min(capacity, mMaxCapacity);
+		for (int block = mStorage.size(); block * blockSize < capacity; ++block)
+		{
+			mStorage.emplace_back(std::make_unique<Block>());
+			mBlocks[block].store(mStorage.back().get(), std::memory_order_release);
+		}
+		if (capacity > mCapacity.load(std::memory_order_relaxed))
+			mCapacity.store(capacity, std::memory_order_release);
+	}
+
+
+	void ParameterFeedback::write(int index, float normalizedValue)
+	{
+		if (index < 0 || index >= mCapacity.load(std::memory_order_relaxed))
+			return;
+
+		auto& slot = getSlot(index);
+		slot.mValue.store(normalizedValue, std::memory_order_relaxed);
+		slot.mDirty.store(true, std::memory_order_release);
+		if (index >= mUsedCount.load(std::memory_order_relaxed))
+			mUsedCount.store(index + 1, std::memory_order_release);
+		mPending.store(true, std::memory_order_release);
+	}
+
+
+	void ParameterFeedback::read(const EditFunction& edit)
+	{
+		if (!mPending.exchange(false, std::memory_order_acquire))
+			return;
+
+		// A write racing this scan either shows up now or raises mPending again for the next read
+		int usedCount = mUsedCount.load(std::memory_order_acquire);
+		for (auto i = 0; i < usedCount; ++i)
+		{
+			auto& slot = getSlot(i);
+			if (slot.mDirty.exchange(false, std::memory_order_acquire))
+				edit(i, slot.mValue.load(std::memory_order_relaxed));
+		}
+	}
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+
+namespace nap
+{
+
+	// Carries parameter changes made on the control thread, by the editor, to another thread without locking.
+	// Every parameter has one slot with its latest normalized value and a dirty flag, so any number of changes
+	// between two reads reach the reader as a single edit. One writing and one reading thread.
+	// Slots come in blocks that the writer adds as parameters are added, readers pick them up through atomic pointers.
+	class ParameterFeedback
+	{
+	public:
+		using EditFunction = std::function<void(int index, float normalizedValue)>;
+		static constexpr int blockSize = 64;
+
+		// Not thread safe, call before either thread uses it. Room for capacity slots, growing up to maxCapacity.
+		void init(int capacity, int maxCapacity);
+		int getCapacity() const { return mCapacity.load(std::memory_order_acquire); }
+
+		// Writer, adds slots for parameters registered since init()
+		void grow(int capacity);
+
+		// Writer. Indices beyond the capacity are ignored.
+		void write(int index, float normalizedValue);
+		void setGestureActive(bool active) { mGestureActive.store(active, std::memory_order_release); }
+
+		// Reader, calls edit for every parameter written since the last read
+		void read(const EditFunction& edit);
+		bool isGestureActive() const { return mGestureActive.load(std::memory_order_acquire); }
+
+	private:
+		struct Slot
+		{
+			std::atomic<float> mValue = { 0.f };
+			std::atomic<bool> mDirty = { false };
+		};
+
+		struct Block
+		{
+			Slot mSlots[blockSize];
+		};
+
+		Slot& getSlot(int index) const { return mBlocks[index / blockSize].load(std::memory_order_acquire)->mSlots[index % blockSize]; }
+
+		std::vector<std::unique_ptr<Block>> mStorage;		// Writer
+		std::unique_ptr<std::atomic<Block*>[]> mBlocks;
+		int mMaxCapacity = 0;
+		std::atomic<int> mCapacity = { 0 };
+		std::atomic<int> mUsedCount = { 0 };		// Highest written index + 1, bounds the reader's scan
+		std::atomic<bool> mPending = { false };
+		std::atomic<bool> mGestureActive = { false };
+	};
+
+}
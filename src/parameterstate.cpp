@@ -0,0 +1,112 @@
+#include "parameterstate.h"
+
+#include <mathutils.h>
+#include <parameternumeric.h>
+#include <parameterdropdown.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace nap
+{
+
+	static void hashBytes(uint32_t& hash, const void* data, size_t size)
+	{
+		// FNV-1a
+		auto bytes = static_cast<const uint8_t*>(data);
+		for (auto i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 16777619u;
+		}
+	}
+
+
+	uint32_t getParameterSchemaHash(const std::vector<Parameter*>& parameters)
+	{
+		uint32_t hash = 2166136261u;
+		for (auto parameter : parameters)
+		{
+			// Parameters removed by a resource reload keep their slot
+			if (parameter == nullptr)
+			{
+				hashBytes(hash, "", 1);
+				continue;
+			}
+			hashBytes(hash, parameter->mID.data(), parameter->mID.size() + 1);
+			auto typeName = parameter->get_type().get_name().to_string();
+			hashBytes(hash, typeName.data(), typeName.size() + 1);
+			auto dropDown = rtti_cast<const ParameterDropDown>(parameter);
+			if (dropDown != nullptr)
+			{
+				uint32_t itemCount = dropDown->mItems.size();
+				hashBytes(hash, &itemCount, sizeof(itemCount));
+			}
+		}
+		return hash;
+	}
+
+
+	bool isIntegralParameter(const Parameter& parameter)
+	{
+		return parameter.get_type().is_derived_from<ParameterInt>() || parameter.get_type().is_derived_from<ParameterDropDown>();
+	}
+
+
+	float getParameterValue(const Parameter& parameter)
+	{
+		if (auto floatParam = rtti_cast<const ParameterFloat>(&parameter))
+			return floatParam->mValue;
+		if (auto intParam = rtti_cast<const ParameterInt>(&parameter))
+			return intParam->mValue;
+		if (auto optionParam = rtti_cast<const ParameterDropDown>(&parameter))
+			return optionParam->mSelectedIndex;
+		return 0.f;
+	}
+
+
+	void setParameterValue(Parameter& parameter, float value)
+	{
+		if (auto floatParam = rtti_cast<ParameterFloat>(&parameter))
+			floatParam->setValue(value);
+		else if (auto intParam = rtti_cast<ParameterInt>(&parameter))
+			intParam->setValue(std::lround(value));
+		else if (auto optionParam = rtti_cast<ParameterDropDown>(&parameter))
+			optionParam->setSelectedIndex(std::lround(value));
+	}
+
+
+	float normalizeParameterValue(const Parameter& parameter, float value)
+	{
+		float minimum = 0.f;
+		float maximum = 1.f;
+		if (auto floatParam = rtti_cast<const ParameterFloat>(&parameter))
+		{
+			minimum = floatParam->mMinimum;
+			maximum = floatParam->mMaximum;
+		}
+		else if (auto intParam = rtti_cast<const ParameterInt>(&parameter))
+		{
+			minimum = intParam->mMinimum;
+			maximum = intParam->mMaximum;
+		}
+		else if (auto optionParam = rtti_cast<const ParameterDropDown>(&parameter))
+		{
+			maximum = std::max<int>(optionParam->mItems.size() - 1, 0);
+		}
+		return maximum > minimum ? std::clamp((value - minimum) / (maximum - minimum), 0.f, 1.f) : 0.f;
+	}
+
+
+	float denormalizeParameterValue(const Parameter& parameter, float normalized)
+	{
+		if (auto floatParam = rtti_cast<const ParameterFloat>(&parameter))
+			return math::fit<float>(normalized, 0.f, 1.f, floatParam->mMinimum, floatParam->mMaximum);
+		if (auto intParam = rtti_cast<const ParameterInt>(&parameter))
+			return std::round(math::fit<float>(normalized, 0.f, 1.f, intParam->mMinimum, intParam->mMaximum));
+		if (auto optionParam = rtti_cast<const ParameterDropDown>(&parameter))
+			return std::round(math::fit<float>(normalized, 0.f, 1.f, 0, optionParam->mItems.size() - 1));
+		return 0.f;
+	}
+
+}
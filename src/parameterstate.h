@@ -0,0 +1,28 @@
+#pragma once
+
+#include <parameter.h>
+
+#include <cstdint>
+#include <vector>
+
+
+namespace nap
+{
+
+	// Helpers to read and write the plugin parameters as plain values.
+	// Plain values are the parameter's own units: the float or int value, or the selected index of a dropdown.
+
+	// Hash of the ids and types of the parameters, used to check that stored values match the current layout
+	uint32_t getParameterSchemaHash(const std::vector<Parameter*>& parameters);
+
+	// True for parameters that store a whole number: ints and dropdowns
+	bool isIntegralParameter(const Parameter& parameter);
+
+	float getParameterValue(const Parameter& parameter);
+	void setParameterValue(Parameter& parameter, float value);
+
+	// Conversion between plain values and the 0-1 range used by the host
+	float normalizeParameterValue(const Parameter& parameter, float value);
+	float denormalizeParameterValue(const Parameter& parameter, float normalized);
+
+}
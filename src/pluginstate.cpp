@@ -0,0 +1,173 @@
+#include "pluginstate.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace nap
+{
+
+	namespace
+	{
+
+		// Fixed byte order independent of the host
+		class Writer
+		{
+		public:
+			Writer(std::vector<char>& data) : mData(data) { }
+
+			void writeInt(uint32_t value)
+			{
+				for (auto i = 0; i < 4; ++i)
+					mData.emplace_back(char((value >> (8 * i)) & 0xff));
+			}
+
+			void writeFloat(float value)
+			{
+				uint32_t bits;
+				std::memcpy(&bits, &value, sizeof(bits));
+				writeInt(bits);
+			}
+
+		private:
+			std::vector<char>& mData;
+		};
+
+
+		class Reader
+		{
+		public:
+			Reader(const char* data, size_t size) : mData(data), mSize(size) { }
+
+			bool readInt(uint32_t& value)
+			{
+				if (mSize - mPosition < 4)
+					return false;
+				value = 0;
+				for (auto i = 0; i < 4; ++i)
+					value |= uint32_t(uint8_t(mData[mPosition++])) << (8 * i);
+				return true;
+			}
+
+			bool readInt(int32_t& value)
+			{
+				uint32_t bits;
+				if (!readInt(bits))
+					return false;
+				value = int32_t(bits);
+				return true;
+			}
+
+			bool readFloat(float& value)
+			{
+				uint32_t bits;
+				if (!readInt(bits))
+					return false;
+				std::memcpy(&value, &bits, sizeof(value));
+				return true;
+			}
+
+		private:
+			const char* mData;
+			size_t mSize;
+			size_t mPosition = 0;
+		};
+
+	}
+
+
+	std::vector<char> PluginState::write(const std::vector<bool>& integral) const
+	{
+		std::vector<char> data;
+		data.reserve(40 + 4 * mValues.size());
+		Writer writer(data);
+		writer.writeInt(magic);
+		writer.writeInt(version);
+		writer.writeInt(mBypass ? 1 : 0);
+		writer.writeInt(mRealtimeOversampling);
+		writer.writeInt(mOfflineOversampling);
+		writer.writeInt(mPresetIndex);
+		writer.writeInt(mMorphTargetIndex);
+		writer.writeFloat(mMorphAmount);
+		writer.writeInt(mSchemaHash);
+		writer.writeInt(mValues.size());
+		for (auto i = 0; i < mValues.size(); ++i)
+		{
+			if (i < integral.size() && integral[i])
+				writer.writeInt(uint32_t(int32_t(std::lround(mValues[i]))));
+			else
+				writer.writeFloat(mValues[i]);
+		}
+		return data;
+	}
+
+
+	PluginState::EReadResult PluginState::read(const char* data, size_t size, const std::vector<bool>& integral)
+	{
+		Reader reader(data, size);
+		int32_t header = 0;
+		if (!reader.readInt(header))
+			return EReadResult::Invalid;
+
+		if (header != magic)
+		{
+			mBypass = header > 0;
+			return EReadResult::BypassOnly;
+		}
+
+		// Everything is checked before any field is taken over
+		int32_t savedVersion = 0;
+		int32_t savedBypass = 0;
+		int32_t realtimeOversampling = 0;
+		int32_t offlineOversampling = 0;
+		int32_t presetIndex = 0;
+		int32_t morphTargetIndex = 0;
+		float morphAmount = 0.f;
+		uint32_t schemaHash = 0;
+		int32_t valueCount = 0;
+		if (!reader.readInt(savedVersion) || savedVersion < 1 || savedVersion > version ||
+			!reader.readInt(savedBypass) ||
+			!reader.readInt(realtimeOversampling) || !isValidOversampling(realtimeOversampling) ||
+			!reader.readInt(offlineOversampling) || !isValidOversampling(offlineOversampling))
+			return EReadResult::Invalid;
+		if (savedVersion >= 2 &&
+			(!reader.readInt(presetIndex) || presetIndex < 0 ||
+			!reader.readInt(morphTargetIndex) || morphTargetIndex < 0 ||
+			!reader.readFloat(morphAmount) || !(morphAmount >= 0.f && morphAmount <= 1.f)))
+			return EReadResult::Invalid;
+		if (!reader.readInt(schemaHash) ||
+			!reader.readInt(valueCount) || valueCount < 0 || size_t(valueCount) > size / 4)
+			return EReadResult::Invalid;
+
+		std::vector<float> values(valueCount);
+		for (auto i = 0; i < valueCount; ++i)
+		{
+			// Both value types are four bytes, values of an unknown layout can still be skipped
+			if (i < integral.size() && integral[i])
+			{
+				int32_t intValue = 0;
+				if (!reader.readInt(intValue))
+					return EReadResult::Invalid;
+				values[i] = intValue;
+			}
+			else if (!reader.readFloat(values[i]))
+				return EReadResult::Invalid;
+		}
+
+		mBypass = savedBypass > 0;
+		mRealtimeOversampling = realtimeOversampling;
+		mOfflineOversampling = offlineOversampling;
+		mPresetIndex = presetIndex;
+		mMorphTargetIndex = morphTargetIndex;
+		mMorphAmount = morphAmount;
+		mSchemaHash = schemaHash;
+		mValues = std::move(values);
+		return EReadResult::Full;
+	}
+
+
+	bool PluginState::isValidOversampling(int32_t factor)
+	{
+		return factor == 1 || factor == 2 || factor == 4 || factor == 8;
+	}
+
+}
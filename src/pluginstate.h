@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace nap
+{
+
+	// Contents of the plugin's state chunk, independent of the host stream.
+	// Layout, little endian: int32 magic, int32 version, int32 bypass, int32 realtime oversampling, int32 offline oversampling,
+	// since version 2 int32 preset index, int32 morph target index, float32 morph amount,
+	// uint32 parameter schema hash, int32 parameter count, then per parameter a float32 or an int32 for int and dropdown parameters.
+	// Chunks without the magic are from before this layout and only hold the bypass flag.
+	struct PluginState
+	{
+		static constexpr int32_t magic = 0x5353564e;	// "NVSS"
+		static constexpr int32_t version = 2;
+
+		enum class EReadResult
+		{
+			Full,			// Every field was read
+			BypassOnly,		// An old chunk, only mBypass is valid
+			Invalid			// Truncated, from a newer version or holding values out of range
+		};
+
+		bool mBypass = false;
+		int32_t mRealtimeOversampling = 1;
+		int32_t mOfflineOversampling = 1;
+		int32_t mPresetIndex = 0;			// Left at 0 by version 1 chunks
+		int32_t mMorphTargetIndex = 0;
+		float mMorphAmount = 0.f;
+		uint32_t mSchemaHash = 0;
+		std::vector<float> mValues;		// Plain values, see parameterstate.h
+
+		// integral tells per value whether it is stored as an int32, values beyond its size are read as float32
+		std::vector<char> write(const std::vector<bool>& integral) const;
+		EReadResult read(const char* data, size_t size, const std::vector<bool>& integral);
+
+		// Oversampling settings the plugin accepts
+		static bool isValidOversampling(int32_t factor);
+	};
+
+}
@@ -0,0 +1,220 @@
+#include "presetbank.h"
+#include "parameterstate.h"
+
+#include <nap/logger.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace nap
+{
+
+	// Preset file layout, little endian:
+	// uint32 magic, uint32 version, uint32 parameter schema hash, uint32 parameter count, then a float32 plain value per parameter
+	static constexpr uint32_t presetMagic = 0x5053564e; // "NVSP"
+	static constexpr uint32_t presetVersion = 1;
+	static constexpr const char* presetExtension = ".preset";
+
+
+	static void writeUInt32(std::ofstream& stream, uint32_t value)
+	{
+		char bytes[4] = { char(value), char(value >> 8), char(value >> 16), char(value >> 24) };
+		stream.write(bytes, 4);
+	}
+
+
+	static bool readUInt32(std::ifstream& stream, uint32_t& value)
+	{
+		unsigned char bytes[4];
+		if (!stream.read(reinterpret_cast<char*>(bytes), 4))
+			return false;
+		value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (uint32_t(bytes[3]) << 24);
+		return true;
+	}
+
+
+	void PresetBank::load(const std::string& factoryDirectory, const std::string& userDirectory, const std::vector<Parameter*>& parameters)
+	{
+		mUserDirectory = userDirectory;
+
+		auto defaults = std::make_unique<ParameterSnapshot>();
+		defaults->mName = "Default";
+		for (auto parameter : parameters)
+			defaults->mValues.emplace_back(normalizeParameterValue(*parameter, getParameterValue(*parameter)));
+		add(std::move(defaults));
+
+		loadDirectory(factoryDirectory, parameters);
+		if (!userDirectory.empty() && userDirectory != factoryDirectory)
+			loadDirectory(userDirectory, parameters);
+	}
+
+
+	void PresetBank::loadDirectory(const std::string& directory, const std::vector<Parameter*>& parameters)
+	{
+		std::error_code error;
+		if (!std::filesystem::is_directory(directory, error))
+			return;
+
+		std::vector<std::filesystem::path> files;
+		for (auto& entry : std::filesystem::directory_iterator(directory, error))
+			if (entry.path().extension() == presetExtension)
+				files.emplace_back(entry.path());
+		std::sort(files.begin(), files.end());
+
+		auto schemaHash = getParameterSchemaHash(parameters);
+		for (auto& file : files)
+		{
+			std::ifstream stream(file, std::ios::binary);
+			uint32_t magic = 0, version = 0, hash = 0, count = 0;
+			if (!readUInt32(stream, magic) || magic != presetMagic ||
+				!readUInt32(stream, version) || version > presetVersion ||
+				!readUInt32(stream, hash) || !readUInt32(stream, count))
+			{
+				Logger::warn("Skipping invalid preset: %s", file.string().c_str());
+				continue;
+			}
+
+			if (hash != schemaHash || count != parameters.size())
+			{
+				Logger::warn("Skipping preset made for a different parameter layout: %s", file.string().c_str());
+				continue;
+			}
+
+			auto snapshot = std::make_unique<ParameterSnapshot>();
+			snapshot->mName = file.stem().string();
+			for (auto i = 0; i < count; ++i)
+			{
+				uint32_t bits = 0;
+				if (!readUInt32(stream, bits))
+					break;
+				float value;
+				std::memcpy(&value, &bits, sizeof(value));
+				snapshot->mValues.emplace_back(normalizeParameterValue(*parameters[i], value));
+			}
+
+			if (snapshot->mValues.size() == count)
+				add(std::move(snapshot));
+		}
+	}
+
+
+	int PresetBank::save(const std::string& name, const std::vector<Parameter*>& parameters, utility::ErrorState& errorState)
+	{
+		if (!errorState.check(getCount() < maxPresetCount, "Preset bank is full"))
+			return -1;
+
+		auto fileName = sanitizeName(name);
+		if (!errorState.check(!fileName.empty(), "Invalid preset name: %s", name.c_str()))
+			return -1;
+		for (auto i = 0; i < getCount(); ++i)
+			if (!errorState.check(getPreset(i).mName != fileName, "A preset named %s exists already", fileName.c_str()))
+				return -1;
+		if (!errorState.check(!mUserDirectory.empty(), "No directory to save presets to"))
+			return -1;
+
+		std::error_code error;
+		std::filesystem::create_directories(mUserDirectory, error);
+		auto path = std::filesystem::path(mUserDirectory) / (fileName + presetExtension);
+		std::ofstream stream(path, std::ios::binary);
+		if (!errorState.check(stream.is_open(), "Unable to write preset: %s", path.string().c_str()))
+			return -1;
+
+		auto snapshot = std::make_unique<ParameterSnapshot>();
+		snapshot->mName = fileName;
+		writeUInt32(stream, presetMagic);
+		writeUInt32(stream, presetVersion);
+		writeUInt32(stream, getParameterSchemaHash(parameters));
+		writeUInt32(stream, parameters.size());
+		for (auto parameter : parameters)
+		{
+			float value = parameter != nullptr ? getParameterValue(*parameter) : 0.f;
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			writeUInt32(stream, bits);
+			snapshot->mValues.emplace_back(parameter != nullptr ? normalizeParameterValue(*parameter, value) : 0.f);
+		}
+
+		if (!errorState.check(stream.good(), "Unable to write preset: %s", path.string().c_str()))
+			return -1;
+
+		add(std::move(snapshot));
+		return getCount() - 1;
+	}
+
+
+	std::string PresetBank::getUserDirectory(const std::string& vendor, const std::string& plugin)
+	{
+		std::filesystem::path base;
+#if defined(_WIN32)
+		if (auto profile = std::getenv("USERPROFILE"))
+			base = std::filesystem::path(profile) / "Documents" / "VST3 Presets";
+#elif defined(__APPLE__)
+		if (auto home = std::getenv("HOME"))
+			base = std::filesystem::path(home) / "Library" / "Audio" / "Presets";
+#else
+		auto dataHome = std::getenv("XDG_DATA_HOME");
+		if (dataHome != nullptr && dataHome[0] == '/')
+			base = std::filesystem::path(dataHome) / "VST3 Presets";
+		else if (auto home = std::getenv("HOME"))
+			base = std::filesystem::path(home) / ".local" / "share" / "VST3 Presets";
+#endif
+		if (base.empty())
+			return { };
+		return (base / sanitizeName(vendor) / sanitizeName(plugin)).string();
+	}
+
+
+	std::string PresetBank::sanitizeName(const std::string& name)
+	{
+		std::string result;
+		for (auto character : name)
+		{
+			if (static_cast<unsigned char>(character) < 0x20 || std::strchr("/\\:*?\"<>|", character) != nullptr)
+				continue;
+			result += character;
+		}
+
+		// Windows drops trailing dots and spaces, leading ones make hidden or odd files elsewhere
+		auto first = result.find_first_not_of(" .");
+		if (first == std::string::npos)
+			return { };
+		result = result.substr(first, result.find_last_not_of(" .") - first + 1);
+
+		std::string upper;
+		for (auto character : result.substr(0, result.find('.')))
+			upper += std::toupper(static_cast<unsigned char>(character));
+		static const char* reservedNames[] = { "CON", "PRN", "AUX", "NUL", "COM1", "COM2", "COM3", "COM4", "COM5", "COM6", "COM7", "COM8", "COM9",
+			"LPT1", "LPT2", "LPT3", "LPT4", "LPT5", "LPT6", "LPT7", "LPT8", "LPT9" };
+		for (auto reserved : reservedNames)
+			if (upper == reserved)
+				return { };
+		return result;
+	}
+
+
+	void PresetBank::morph(const ParameterSnapshot& from, const ParameterSnapshot& to, float amount, std::vector<float>& output)
+	{
+		// Plain loop over contiguous floats, vectorized by the compiler
+		const float* a = from.mValues.data();
+		const float* b = to.mValues.data();
+		float* out = output.data();
+		const auto count = output.size();
+		for (auto i = 0; i < count; ++i)
+			out[i] = a[i] + (b[i] - a[i]) * amount;
+	}
+
+
+	void PresetBank::add(std::unique_ptr<ParameterSnapshot> snapshot)
+	{
+		auto count = mCount.load(std::memory_order_relaxed);
+		if (count >= maxPresetCount)
+			return;
+		mPresets[count] = std::move(snapshot);
+		mCount.store(count + 1, std::memory_order_release);
+	}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <parameter.h>
+#include <utility/errorstate.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace nap
+{
+
+	// Immutable set of normalized parameter values, in parameter registration order
+	struct ParameterSnapshot
+	{
+		std::string mName;
+		std::vector<float> mValues;
+	};
+
+
+	// Presets decoded up front, so switching only means picking a snapshot.
+	// Presets are added from the control thread, any thread can read the ones below getCount().
+	class PresetBank
+	{
+	public:
+		static constexpr int maxPresetCount = 128;
+
+		// Adds the current parameter values as the default preset, followed by every preset file that matches the parameter layout:
+		// first the factory presets shipped with the plugin, which are never written to, then the user's own presets
+		void load(const std::string& factoryDirectory, const std::string& userDirectory, const std::vector<Parameter*>& parameters);
+
+		// Writes the current parameter values to a preset file in the user directory and adds it to the bank, returns its index or -1.
+		// The file is named after the sanitized name, which is also the name of the new preset.
+		int save(const std::string& name, const std::vector<Parameter*>& parameters, utility::ErrorState& errorState);
+
+		// Where a user's presets go: Documents/VST3 Presets on Windows, ~/Library/Audio/Presets on macOS and
+		// the XDG data directory elsewhere, each followed by vendor/plugin
+		static std::string getUserDirectory(const std::string& vendor, const std::string& plugin);
+
+		// Drops path separators, characters reserved in file names and surrounding spaces and dots.
+		// Empty when nothing usable is left or the result is a reserved device name on Windows.
+		static std::string sanitizeName(const std::string& name);
+
+		int getCount() const { return mCount.load(std::memory_order_acquire); }
+		const ParameterSnapshot& getPreset(int index) const { return *mPresets[index]; }
+
+		// Blends two presets into output, which has to hold as many values as the presets
+		static void morph(const ParameterSnapshot& from, const ParameterSnapshot& to, float amount, std::vector<float>& output);
+
+	private:
+		void loadDirectory(const std::string& directory, const std::vector<Parameter*>& parameters);
+		void add(std::unique_ptr<ParameterSnapshot> snapshot);
+
+		std::string mUserDirectory;
+		std::array<std::unique_ptr<ParameterSnapshot>, maxPresetCount> mPresets;
+		std::atomic<int> mCount = { 0 };
+	};
+
+}
@@ -0,0 +1,202 @@
+#include "telemetry.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace nap
+{
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "Telemetry counters have to be lock free to be shared between processes");
+
+#ifndef _WIN32
+	static std::string getTelemetryDirectory()
+	{
+		// The per-user runtime directory is private already
+		const char* runtimeDirectory = std::getenv("XDG_RUNTIME_DIR");
+		std::error_code error;
+		if (runtimeDirectory != nullptr && runtimeDirectory[0] == '/' && std::filesystem::is_directory(runtimeDirectory, error))
+			return runtimeDirectory;
+
+		// Otherwise a directory of our own in the shared temp directory, which someone else may have planted
+		auto directory = (std::filesystem::temp_directory_path(error) / ("napvst-" + std::to_string(getuid()))).string();
+		::mkdir(directory.c_str(), 0700);
+		struct stat info;
+		if (::lstat(directory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode) || info.st_uid != getuid() || (info.st_mode & 0077) != 0)
+			return std::string();
+		return directory;
+	}
+#endif
+
+
+	void Telemetry::open()
+	{
+		close();
+
+#ifndef _WIN32
+		// mkstemps creates a new file only readable by the user, it never opens an existing file or follows a link
+		auto directory = getTelemetryDirectory();
+		int fd = -1;
+		if (!directory.empty())
+		{
+			const std::string suffix = ".telemetry";
+			auto path = directory + "/napvst-" + std::to_string(getpid()) + "-XXXXXX" + suffix;
+			fd = ::mkstemps(path.data(), suffix.size());
+			if (fd >= 0)
+				mPath = path;
+		}
+		if (fd >= 0)
+		{
+			if (ftruncate(fd, sizeof(Layout)) == 0)
+			{
+				void* memory = mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+				if (memory != MAP_FAILED)
+				{
+					mLayout = new (memory) Layout();
+					mMapped = true;
+				}
+			}
+			::close(fd);
+			if (!mMapped)
+				::unlink(mPath.c_str());
+		}
+#endif
+
+		// Counters still show up in the editor without a file
+		if (mLayout == nullptr)
+		{
+			mPath.clear();
+			mLayout = new Layout();
+		}
+
+		mLayout->mMagic = magic;
+		mLayout->mVersion = version;
+		mLayout->mHistogramBinCount = histogramBinCount;
+		mLayout->mRingSize = ringSize;
+	}
+
+
+	void Telemetry::close()
+	{
+		if (mLayout == nullptr)
+			return;
+
+#ifndef _WIN32
+		if (mMapped)
+		{
+			munmap(mLayout, sizeof(Layout));
+
+			// Only kept around for post-mortem inspection when asked for
+			if (std::getenv("NAPVST_KEEP_TELEMETRY") == nullptr)
+				::unlink(mPath.c_str());
+		}
+		else
+			delete mLayout;
+#else
+		delete mLayout;
+#endif
+		mLayout = nullptr;
+		mMapped = false;
+	}
+
+
+	void Telemetry::recordBlock(double processTime, double budget)
+	{
+		if (mLayout == nullptr)
+			return;
+
+		double load = budget > 0.0 ? processTime / budget : 0.0;
+		auto block = mLayout->mBlockCount.load(std::memory_order_relaxed);
+		if (load > 1.0)
+			mLayout->mDeadlineMissCount.fetch_add(1, std::memory_order_relaxed);
+		auto bin = std::min<uint32_t>(load * 10.0, histogramBinCount - 1);
+		mLayout->mHistogram[bin].fetch_add(1, std::memory_order_relaxed);
+
+		auto& record = mLayout->mRing[block % ringSize];
+		record.mBlockIndex.store(block, std::memory_order_relaxed);
+		record.mProcessTime.store(processTime * 1e6, std::memory_order_relaxed);
+		record.mBudget.store(budget * 1e6, std::memory_order_relaxed);
+		mLayout->mBlockCount.store(block + 1, std::memory_order_release);
+	}
+
+
+	void Telemetry::recordControlTick(double tickTime, double period)
+	{
+		if (mLayout == nullptr)
+			return;
+
+		mLayout->mControlTickCount.fetch_add(1, std::memory_order_relaxed);
+		if (tickTime > period)
+			mLayout->mControlOverrunCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+
+	void Telemetry::recordRenderFrame(double buildTime, double recordTime, double submitTime, double waitTime)
+	{
+		if (mLayout == nullptr)
+			return;
+
+		uint32_t microseconds = (buildTime + recordTime + submitTime + waitTime) * 1e6;
+		mLayout->mRenderFrameCount.fetch_add(1, std::memory_order_relaxed);
+		mLayout->mLastRenderFrameTime.store(microseconds, std::memory_order_relaxed);
+		mLayout->mLastBuildTime.store(buildTime * 1e6, std::memory_order_relaxed);
+		mLayout->mLastRecordTime.store(recordTime * 1e6, std::memory_order_relaxed);
+		mLayout->mLastSubmitTime.store(submitTime * 1e6, std::memory_order_relaxed);
+		mLayout->mLastWaitTime.store(waitTime * 1e6, std::memory_order_relaxed);
+		raise(mLayout->mMaxRenderFrameTime, microseconds);
+	}
+
+
+	void Telemetry::controlTaskEnqueued()
+	{
+		auto depth = mControlQueueDepth.fetch_add(1, std::memory_order_relaxed) + 1;
+		if (mLayout != nullptr)
+			raise(mLayout->mControlQueueHighWater, depth);
+	}
+
+
+	void Telemetry::midiEventEnqueued()
+	{
+		auto depth = mMidiQueueDepth.fetch_add(1, std::memory_order_relaxed) + 1;
+		if (mLayout != nullptr)
+			raise(mLayout->mMidiQueueHighWater, depth);
+	}
+
+
+	float Telemetry::getBlockTimePercentile(float percentile) const
+	{
+		if (mLayout == nullptr)
+			return 0.f;
+
+		uint64_t total = 0;
+		for (auto& bin : mLayout->mHistogram)
+			total += bin.load(std::memory_order_relaxed);
+		if (total == 0)
+			return 0.f;
+
+		uint64_t count = 0;
+		for (auto i = 0; i < histogramBinCount; ++i)
+		{
+			count += mLayout->mHistogram[i].load(std::memory_order_relaxed);
+			if (count >= percentile * total)
+				return (i + 1) * 0.1f;
+		}
+		return histogramBinCount * 0.1f;
+	}
+
+
+	void Telemetry::raise(std::atomic<uint32_t>& highWater, uint32_t value)
+	{
+		auto current = highWater.load(std::memory_order_relaxed);
+		while (value > current && !highWater.compare_exchange_weak(current, value, std::memory_order_relaxed));
+	}
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+
+namespace nap
+{
+
+	// Always-on timing counters for one plugin instance, kept in a memory-mapped file so an external
+	// tool can follow them while the host keeps running. All fields are fixed size and in the host's byte order,
+	// a reader on another machine can tell from mMagic whether to swap them.
+	// Writers only use relaxed atomics, a reader may see a block record that is being overwritten.
+	// The file is removed on close, unless NAPVST_KEEP_TELEMETRY is set in the environment.
+	class Telemetry
+	{
+	public:
+		static constexpr uint32_t magic = 0x5453564e;	// "NVST"
+		static constexpr uint32_t version = 2;
+		static constexpr uint32_t histogramBinCount = 24;	// Block time in steps of 10% of the budget, the last bin collects the rest
+		static constexpr uint32_t ringSize = 1024;
+
+		struct BlockRecord
+		{
+			std::atomic<uint64_t> mBlockIndex;
+			std::atomic<uint32_t> mProcessTime;		// Microseconds
+			std::atomic<uint32_t> mBudget;			// Microseconds
+		};
+
+		struct Layout
+		{
+			uint32_t mMagic;
+			uint32_t mVersion;
+			uint32_t mHistogramBinCount;
+			uint32_t mRingSize;
+			std::atomic<uint64_t> mBlockCount;
+			std::atomic<uint64_t> mDeadlineMissCount;
+			std::atomic<uint64_t> mControlTickCount;
+			std::atomic<uint64_t> mControlOverrunCount;
+			std::atomic<uint64_t> mRenderFrameCount;
+			std::atomic<uint32_t> mLastRenderFrameTime;		// Microseconds
+			std::atomic<uint32_t> mMaxRenderFrameTime;		// Microseconds
+			std::atomic<uint32_t> mLastBuildTime;			// Microseconds spent building the ImGui frame
+			std::atomic<uint32_t> mLastRecordTime;			// Microseconds spent recording render commands
+			std::atomic<uint32_t> mLastSubmitTime;			// Microseconds spent submitting and presenting
+			std::atomic<uint32_t> mLastWaitTime;			// Microseconds spent waiting for a frame in flight
+			std::atomic<uint32_t> mControlQueueHighWater;
+			std::atomic<uint32_t> mMidiQueueHighWater;
+			std::atomic<uint64_t> mHistogram[histogramBinCount];
+			BlockRecord mRing[ringSize];		// Block n is written to index n % ringSize, mBlockCount is the write position
+		};
+
+		Telemetry() = default;
+		~Telemetry() { close(); }
+
+		// Maps a fresh file only the user can read, in $XDG_RUNTIME_DIR or a private directory in the temp directory.
+		// Falls back to process memory when that fails, getPath() is empty then.
+		void open();
+		void close();
+		const std::string& getPath() const { return mPath; }
+
+		// Audio thread
+		void recordBlock(double processTime, double budget);
+
+		// Control thread, period is the configured tick interval
+		void recordControlTick(double tickTime, double period);
+		void recordRenderFrame(double buildTime, double recordTime, double submitTime, double waitTime);
+
+		// Queue depth tracking, enqueue and dequeue may come from different threads
+		void controlTaskEnqueued();
+		void controlTaskDequeued() { mControlQueueDepth.fetch_sub(1, std::memory_order_relaxed); }
+		void midiEventEnqueued();
+		void midiEventsDequeued() { mMidiQueueDepth.store(0, std::memory_order_relaxed); }
+
+		// Block time in fractions of the budget below which the given share of blocks finished
+		float getBlockTimePercentile(float percentile) const;
+
+		const Layout& getLayout() const { return *mLayout; }
+		bool isOpen() const { return mLayout != nullptr; }
+
+	private:
+		static void raise(std::atomic<uint32_t>& highWater, uint32_t value);
+
+		Layout* mLayout = nullptr;
+		bool mMapped = false;
+		std::string mPath;
+		std::atomic<uint32_t> mControlQueueDepth = { 0 };
+		std::atomic<uint32_t> mMidiQueueDepth = { 0 };
+	};
+
+}
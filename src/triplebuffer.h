@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+
+namespace nap
+{
+
+	// Hands the latest version of a value from one writer thread to one reader thread without locking.
+	// The writer fills getWriteBuffer() and publishes it, the reader picks up the most recent publication in update().
+	// Versions published in between are skipped.
+	template <typename T>
+	class TripleBuffer
+	{
+	public:
+		void init(const T& value)
+		{
+			for (auto& buffer : mBuffers)
+				buffer = value;
+		}
+
+		// Writer
+		T& getWriteBuffer() { return mBuffers[mWriteIndex]; }
+		void publish() { mWriteIndex = mShared.exchange(mWriteIndex | dirtyFlag) & indexMask; }
+
+		// Reader, returns true when a new version was published since the last call
+		bool update()
+		{
+			if ((mShared.load() & dirtyFlag) == 0)
+				return false;
+			mReadIndex = mShared.exchange(mReadIndex) & indexMask;
+			return true;
+		}
+		const T& getReadBuffer() const { return mBuffers[mReadIndex]; }
+
+	private:
+		static constexpr int dirtyFlag = 4;
+		static constexpr int indexMask = 3;
+
+		std::array<T, 3> mBuffers;
+		int mWriteIndex = 0;
+		int mReadIndex = 1;
+		std::atomic<int> mShared = { 2 };
+	};
+
+}
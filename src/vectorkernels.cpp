@@ -0,0 +1,67 @@
+#include "vectorkernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Runtime dispatch needs ifunc support from the loader, which only glibc based Linux provides
+#if defined(__x86_64__) && defined(__linux__) && (defined(__GNUC__) || defined(__clang__))
+#define NAPVST_VECTOR_KERNEL __attribute__((target_clones("arch=haswell", "default")))
+#else
+#define NAPVST_VECTOR_KERNEL
+#endif
+
+namespace nap
+{
+
+	namespace simd
+	{
+
+		NAPVST_VECTOR_KERNEL
+		void multiplyAccumulate(float* accumulator, const float* source, float gain, int count)
+		{
+			for (auto i = 0; i < count; ++i)
+				accumulator[i] += gain * source[i];
+		}
+
+
+		NAPVST_VECTOR_KERNEL
+		void measureLevels(const float* samples, int count, float& peak, float& sumOfSquares)
+		{
+			// Eight independent lanes, a single running sum can't be vectorized without reordering the additions
+			constexpr int laneCount = 8;
+			float peaks[laneCount] = { };
+			float sums[laneCount] = { };
+			int i = 0;
+			for (; i + laneCount <= count; i += laneCount)
+			{
+				for (auto lane = 0; lane < laneCount; ++lane)
+				{
+					const float sample = samples[i + lane];
+					peaks[lane] = std::max(peaks[lane], std::abs(sample));
+					sums[lane] += sample * sample;
+				}
+			}
+			for (; i < count; ++i)
+			{
+				peaks[0] = std::max(peaks[0], std::abs(samples[i]));
+				sums[0] += samples[i] * samples[i];
+			}
+
+			for (auto lane = 0; lane < laneCount; ++lane)
+			{
+				peak = std::max(peak, peaks[lane]);
+				sumOfSquares += sums[lane];
+			}
+		}
+
+
+		NAPVST_VECTOR_KERNEL
+		void multiply(float* samples, const float* gains, int count)
+		{
+			for (auto i = 0; i < count; ++i)
+				samples[i] *= gains[i];
+		}
+
+	}
+
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+
+namespace nap
+{
+
+	// Inner loops of the plugin's own DSP: the oversampling filters, the meters and the output fade.
+	// On x86_64 Linux every kernel is compiled twice, for the baseline and for AVX2/FMA,
+	// and the loader binds the variant the CPU supports. Elsewhere the baseline build is the only one,
+	// which is already vectorized with NEON on arm64.
+	namespace simd
+	{
+
+		// accumulator[i] += gain * source[i]
+		void multiplyAccumulate(float* accumulator, const float* source, float gain, int count);
+
+		// Raises peak to the largest absolute sample and adds the squares to sumOfSquares
+		void measureLevels(const float* samples, int count, float& peak, float& sumOfSquares);
+
+		// samples[i] *= gains[i]
+		void multiply(float* samples, const float* gains, int count);
+
+	}
+
+}
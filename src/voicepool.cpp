@@ -0,0 +1,267 @@
+#include "voicepool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace nap
+{
+
+	static int lowestBit(uint64_t mask)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return __builtin_ctzll(mask);
+#else
+		int bit = 0;
+		while ((mask & 1) == 0)
+		{
+			mask >>= 1;
+			bit++;
+		}
+		return bit;
+#endif
+	}
+
+
+	VoicePool::VoicePool()
+	{
+		reset();
+	}
+
+
+	void VoicePool::reset()
+	{
+		mFree = List();
+		mHeld = List();
+		mReleasing = List();
+		for (auto& list : mByVelocity)
+			list = List();
+		for (auto& list : mByNote)
+			list = List();
+		std::fill(std::begin(mVelocityMask), std::end(mVelocityMask), 0);
+		mActiveCount = 0;
+		mReleasingVoiceCount = 0;
+		mTime = 0;
+
+		for (auto i = 0; i < maxCapacity; ++i)
+		{
+			mVoices[i] = Voice();
+			pushBack(mFree, &Voice::mAge, i);
+		}
+		updateCounts();
+	}
+
+
+	int VoicePool::getCapacity() const
+	{
+		return std::clamp(std::min(mCapacity.load(std::memory_order_relaxed), mLimit.load(std::memory_order_relaxed)), 1, maxCapacity);
+	}
+
+
+	int VoicePool::getHeldNotes(Note* notes, int maxCount) const
+	{
+		int count = 0;
+		for (auto i = mHeld.mFirst; i >= 0 && count < maxCount; i = mVoices[i].mAge.mNext)
+		{
+			int note = mVoices[i].mNote;
+			if (mByNote[note].mFirst == i)
+				notes[count++] = { note / pitchCount, note % pitchCount };
+		}
+		return count;
+	}
+
+
+	VoicePool::Note VoicePool::noteOn(int channel, int pitch, int noteId, float velocity)
+	{
+		applyRequests();
+		Note released;
+		if (channel < 0 || channel >= channelCount || pitch < 0 || pitch >= pitchCount)
+			return released;
+		const int note = channel * pitchCount + pitch;
+		const int velocityIndex = std::clamp<int>(std::lround(velocity * (velocityCount - 1)), 0, velocityCount - 1);
+
+		auto policy = mPolicy.load(std::memory_order_relaxed);
+		const int capacity = getCapacity();
+		const bool limited = mLimit.load(std::memory_order_relaxed) < std::min(mCapacity.load(std::memory_order_relaxed), maxCapacity);
+		const bool stealing = policy != EPolicy::Off || limited;
+
+		// The note off releases every voice of the note, they all move on to their release tail
+		if (policy == EPolicy::RetriggerOldest && mByNote[note].mFirst >= 0)
+		{
+			release(note);
+			released = { channel, pitch };
+		}
+
+		if (stealing)
+		{
+			// Release tails go first. MIDI can't address them any more, the synth hands one over on its own.
+			// When there are none, one held note is released. A lowered capacity is reached one note at a time.
+			while (mActiveCount >= capacity && mReleasing.mFirst >= 0)
+				free(mReleasing.mFirst);
+			if (mActiveCount >= capacity && !released.isValid() && mHeld.mFirst >= 0)
+			{
+				int victim = policy == EPolicy::Oldest || policy == EPolicy::RetriggerOldest ? mHeld.mFirst : findQuietest();
+				int victimNote = mVoices[victim].mNote;
+				released = { victimNote / pitchCount, victimNote % pitchCount };
+				release(victimNote);
+				mStolenCount.fetch_add(1, std::memory_order_relaxed);
+				while (mActiveCount >= capacity && mReleasing.mFirst >= 0)
+					free(mReleasing.mFirst);
+			}
+		}
+		else if (mFree.mFirst < 0 && mReleasing.mFirst >= 0)
+		{
+			free(mReleasing.mFirst);
+		}
+
+		// Notes without a voice are still played, their note off is passed on when nothing else holds the note
+		if (mFree.mFirst >= 0 && (!stealing || mActiveCount < capacity))
+			start(note, noteId, velocityIndex);
+		updateCounts();
+		return released;
+	}
+
+
+	bool VoicePool::noteOff(int channel, int pitch, int noteId)
+	{
+		applyRequests();
+		if (channel < 0 || channel >= channelCount || pitch < 0 || pitch >= pitchCount)
+			return false;
+		const int note = channel * pitchCount + pitch;
+
+		// The voice with the host's note id, otherwise the oldest voice of the note that is still down
+		int index = -1;
+		for (auto i = mByNote[note].mFirst; i >= 0 && index < 0; i = mVoices[i].mNoteLinks.mNext)
+			if (!mVoices[i].mNoteOff && noteId >= 0 && mVoices[i].mNoteId == noteId)
+				index = i;
+		for (auto i = mByNote[note].mFirst; i >= 0 && index < 0; i = mVoices[i].mNoteLinks.mNext)
+			if (!mVoices[i].mNoteOff)
+				index = i;
+
+		// Stolen or never given a voice
+		if (index < 0)
+			return mByNote[note].mFirst < 0;
+
+		// The synth would release the other voices of the note as well, they keep it held
+		mVoices[index].mNoteOff = true;
+		for (auto i = mByNote[note].mFirst; i >= 0; i = mVoices[i].mNoteLinks.mNext)
+			if (!mVoices[i].mNoteOff)
+				return false;
+
+		release(note);
+		updateCounts();
+		return true;
+	}
+
+
+	void VoicePool::advance(int numSamples)
+	{
+		applyRequests();
+		mTime += numSamples;
+
+		// Releases end in the order they started unless the release length changed in between, then a voice may wait a little longer
+		while (mReleasing.mFirst >= 0 && mVoices[mReleasing.mFirst].mReleaseEnd <= mTime)
+			free(mReleasing.mFirst);
+		updateCounts();
+	}
+
+
+	void VoicePool::applyRequests()
+	{
+		if (mResetRequested.load(std::memory_order_relaxed))
+		{
+			mResetRequested.store(false, std::memory_order_relaxed);
+			reset();
+		}
+	}
+
+
+	void VoicePool::pushBack(List& list, Links Voice::* links, int index)
+	{
+		auto& link = mVoices[index].*links;
+		link.mPrevious = list.mLast;
+		link.mNext = -1;
+		if (list.mLast >= 0)
+			(mVoices[list.mLast].*links).mNext = index;
+		else
+			list.mFirst = index;
+		list.mLast = index;
+	}
+
+
+	void VoicePool::remove(List& list, Links Voice::* links, int index)
+	{
+		auto& link = mVoices[index].*links;
+		if (link.mPrevious >= 0)
+			(mVoices[link.mPrevious].*links).mNext = link.mNext;
+		else
+			list.mFirst = link.mNext;
+		if (link.mNext >= 0)
+			(mVoices[link.mNext].*links).mPrevious = link.mPrevious;
+		else
+			list.mLast = link.mPrevious;
+		link = Links();
+	}
+
+
+	void VoicePool::start(int note, int noteId, int velocity)
+	{
+		int index = mFree.mFirst;
+		remove(mFree, &Voice::mAge, index);
+
+		auto& voice = mVoices[index];
+		voice.mNote = note;
+		voice.mNoteId = noteId;
+		voice.mVelocity = velocity;
+		voice.mNoteOff = false;
+		pushBack(mHeld, &Voice::mAge, index);
+		pushBack(mByVelocity[velocity], &Voice::mVelocityLinks, index);
+		pushBack(mByNote[note], &Voice::mNoteLinks, index);
+		mVelocityMask[velocity / 64] |= uint64_t(1) << (velocity % 64);
+		mActiveCount++;
+	}
+
+
+	void VoicePool::release(int note)
+	{
+		const int64_t releaseEnd = mTime + mReleaseLength.load(std::memory_order_relaxed);
+		while (mByNote[note].mFirst >= 0)
+		{
+			int index = mByNote[note].mFirst;
+			auto& voice = mVoices[index];
+			remove(mHeld, &Voice::mAge, index);
+			remove(mByVelocity[voice.mVelocity], &Voice::mVelocityLinks, index);
+			remove(mByNote[note], &Voice::mNoteLinks, index);
+			if (mByVelocity[voice.mVelocity].mFirst < 0)
+				mVelocityMask[voice.mVelocity / 64] &= ~(uint64_t(1) << (voice.mVelocity % 64));
+			voice.mReleaseEnd = releaseEnd;
+			pushBack(mReleasing, &Voice::mAge, index);
+			mReleasingVoiceCount++;
+		}
+	}
+
+
+	void VoicePool::free(int index)
+	{
+		remove(mReleasing, &Voice::mAge, index);
+		mVoices[index] = Voice();
+		pushBack(mFree, &Voice::mAge, index);
+		mReleasingVoiceCount--;
+		mActiveCount--;
+	}
+
+
+	int VoicePool::findQuietest() const
+	{
+		int word = mVelocityMask[0] != 0 ? 0 : 1;
+		return mByVelocity[word * 64 + lowestBit(mVelocityMask[word])].mFirst;
+	}
+
+
+	void VoicePool::updateCounts()
+	{
+		mHeldCount.store(mActiveCount - mReleasingVoiceCount, std::memory_order_relaxed);
+		mReleasingCount.store(mReleasingVoiceCount, std::memory_order_relaxed);
+	}
+
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+
+namespace nap
+{
+
+	// Decides which notes get a voice, so the synth never has to search for one or steal on its own.
+	// The synth is driven by MIDI, which can only release all voices of a channel and pitch at once.
+	// The pool therefore follows voices by id through held, releasing and free, and only asks for a note off
+	// when it releases every voice of that note. A released voice stays busy until its release tail has run out.
+	// Voices live in one fixed array and are threaded onto intrusive lists by index:
+	// free voices, held voices by age, releasing voices by end time, held voices per velocity and per note.
+	// Used from the audio thread only, except for the setters, which are picked up at the next note.
+	class VoicePool
+	{
+	public:
+		static constexpr int maxCapacity = 128;
+		static constexpr int channelCount = 16;
+		static constexpr int pitchCount = 128;
+		static constexpr int velocityCount = 128;
+
+		enum class EPolicy : int
+		{
+			Off = 0,		// Never steal, the synth steals on its own once it runs out of voices
+			Oldest,			// Steal the voice that started first
+			Quietest,		// Steal the voice with the lowest velocity, the oldest of those
+			RetriggerOldest	// Release the voices already playing the same note, steal the oldest when full
+		};
+
+		// All a MIDI note off can address
+		struct Note
+		{
+			int mChannel = -1;
+			int mPitch = -1;
+			bool isValid() const { return mPitch >= 0; }
+		};
+
+		VoicePool();
+
+		// Forgets all voices, from the audio thread
+		void reset();
+
+		// Forgets all voices at the next note, from any thread. For when the synth was rebuilt.
+		void requestReset() { mResetRequested.store(true, std::memory_order_relaxed); }
+
+		// The synth's own voice count, clamped to maxCapacity
+		void setCapacity(int capacity) { mCapacity.store(capacity, std::memory_order_relaxed); }
+
+		// Lowers the capacity temporarily, notes are stolen to stay below it even when the policy is Off
+		void setLimit(int limit) { mLimit.store(limit, std::memory_order_relaxed); }
+
+		// Samples a voice stays busy after its note off
+		void setReleaseLength(int numSamples) { mReleaseLength.store(numSamples, std::memory_order_relaxed); }
+
+		// noteId is the host's id for the note, -1 when it has none.
+		// Returns the note the synth has to release before this one starts, invalid if there is none.
+		Note noteOn(int channel, int pitch, int noteId, float velocity);
+
+		// Returns true when the synth should receive the note off: no other held voice still plays the note
+		bool noteOff(int channel, int pitch, int noteId);
+
+		// Moves the pool's clock forward, voices at the end of their release become free
+		void advance(int numSamples);
+
+		// Fills notes with every note held by a voice, once per note, and returns their count
+		int getHeldNotes(Note* notes, int maxCount) const;
+
+		int getCapacity() const;
+		int getHeldCount() const { return mHeldCount.load(std::memory_order_relaxed); }
+		int getReleasingCount() const { return mReleasingCount.load(std::memory_order_relaxed); }
+		uint64_t getStolenCount() const { return mStolenCount.load(std::memory_order_relaxed); }
+
+		void setPolicy(EPolicy policy) { mPolicy.store(policy, std::memory_order_relaxed); }
+		EPolicy getPolicy() const { return mPolicy.load(std::memory_order_relaxed); }
+
+	private:
+		static constexpr int noteCount = channelCount * pitchCount;
+
+		struct Links
+		{
+			int mPrevious = -1;
+			int mNext = -1;
+		};
+
+		struct List
+		{
+			int mFirst = -1;
+			int mLast = -1;
+		};
+
+		struct Voice
+		{
+			int mNote = -1;				// channel * pitchCount + pitch
+			int mNoteId = -1;
+			int mVelocity = 0;
+			bool mNoteOff = false;		// Held only because another voice of the same note is
+			int64_t mReleaseEnd = 0;
+			Links mAge;					// Free, held or releasing list
+			Links mVelocityLinks;		// Held only
+			Links mNoteLinks;			// Held only
+		};
+
+		void pushBack(List& list, Links Voice::* links, int index);
+		void remove(List& list, Links Voice::* links, int index);
+		void applyRequests();
+		void start(int note, int noteId, int velocity);
+		void release(int note);
+		void free(int index);		// Releasing voices only
+		int findQuietest() const;
+		void updateCounts();
+
+		Voice mVoices[maxCapacity];
+		List mFree;
+		List mHeld;									// Oldest first
+		List mReleasing;							// Released first
+		List mByVelocity[velocityCount];			// Oldest first within a velocity
+		List mByNote[noteCount];					// Oldest first within a note
+		uint64_t mVelocityMask[velocityCount / 64] = { 0, 0 };	// Velocities with held voices
+		int mActiveCount = 0;						// Held and releasing
+		int mReleasingVoiceCount = 0;
+		int64_t mTime = 0;
+
+		std::atomic<EPolicy> mPolicy = { EPolicy::Off };
+		std::atomic<int> mCapacity = { maxCapacity };
+		std::atomic<int> mLimit = { maxCapacity };
+		std::atomic<int> mReleaseLength = { 0 };
+		std::atomic<bool> mResetRequested = { false };
+		std::atomic<int> mHeldCount = { 0 };
+		std::atomic<int> mReleasingCount = { 0 };
+		std::atomic<uint64_t> mStolenCount = { 0 };
+	};
+
+}
@@ -0,0 +1,74 @@
+#include "check.h"
+
+#include <analysistap.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+// Writes numSamples of a signal in blocks of 512 samples
+template <typename Signal>
+static void writeSignal(nap::AnalysisTap& tap, int numSamples, Signal signal)
+{
+	std::vector<float> left(512), right(512);
+	for (auto start = 0; start < numSamples; start += 512)
+	{
+		for (auto i = 0; i < 512; ++i)
+		{
+			left[i] = signal(start + i);
+			right[i] = left[i];
+		}
+		const float* channels[] = { left.data(), right.data() };
+		tap.write(channels, 2, 512);
+	}
+}
+
+
+int main()
+{
+	// A full scale sine centered on fft bin 64 reads 0 dB in the band that holds it, and little far away from it
+	const float sampleRate = 48000.f;
+	const float frequency = 64 * sampleRate / nap::AnalysisTap::fftSize;
+	nap::AnalysisTap tap;
+	writeSignal(tap, nap::AnalysisTap::fftSize, [&](int i) { return float(std::sin(2.0 * M_PI * frequency * i / sampleRate)); });
+	CHECK(std::abs(tap.getPeak() - 1.f) < 1e-3f);
+	CHECK(std::abs(tap.getRMS() - std::sqrt(0.5f)) < 1e-2f);
+	tap.update();
+	tap.analyse(sampleRate);
+
+	auto& spectrum = tap.getSpectrum();
+	auto getBand = [&](float frequency)
+	{
+		return int(nap::AnalysisTap::spectrumBinCount * std::log(frequency / 20.f) / std::log(0.5f * sampleRate / 20.f));
+	};
+	const int band = getBand(frequency);
+	const auto loudest = std::max_element(spectrum.begin(), spectrum.end()) - spectrum.begin();
+	CHECK(std::abs(spectrum[band]) < 0.5f);
+	CHECK(std::abs(loudest - band) <= 1);
+	CHECK(spectrum[getBand(100.f)] < -60.f);
+	CHECK(spectrum[getBand(10000.f)] < -60.f);
+
+	// The scope shows the most recent samples
+	CHECK(std::abs(*std::max_element(tap.getScope().begin(), tap.getScope().end()) - 1.f) < 1e-2f);
+
+	// Nothing is published while the reader is behind: a full ring keeps what it has until it was collected
+	nap::AnalysisTap behind;
+	writeSignal(behind, nap::AnalysisTap::ringSize, [](int) { return 0.25f; });
+	CHECK(behind.getSkippedCount() == 0);
+	writeSignal(behind, 512, [](int) { return 0.5f; });
+	CHECK(behind.getSkippedCount() == 1);
+	CHECK(behind.getPeak() == 0.5f);
+	behind.update();
+	behind.analyse(sampleRate);
+	CHECK(behind.getScope().back() == 0.25f);
+
+	// Collected, the ring takes new blocks again
+	writeSignal(behind, 512, [](int) { return 0.5f; });
+	CHECK(behind.getSkippedCount() == 1);
+	behind.update();
+	behind.analyse(sampleRate);
+	CHECK(behind.getScope().back() == 0.5f);
+	CHECK(behind.getScope().front() == 0.25f);
+	return 0;
+}
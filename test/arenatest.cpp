@@ -0,0 +1,43 @@
+#include "check.h"
+
+#include <arena.h>
+
+#include <cstdint>
+
+
+int main()
+{
+	nap::Arena arena;
+
+	// First round: small chunks growing with the reservation, no huge pages for them
+	size_t requested = 0;
+	for (auto i = 0; i < 200; ++i)
+	{
+		auto size = 1000 + 37 * i;
+		auto memory = static_cast<unsigned char*>(arena.allocate(size));
+		CHECK(reinterpret_cast<uintptr_t>(memory) % nap::Arena::alignment == 0);
+		for (auto j = 0; j < size; ++j)
+			CHECK(memory[j] == 0);
+		requested += size;
+	}
+	const auto used = arena.getUsedSize();
+	CHECK(used >= requested);
+	CHECK(arena.getReservedSize() <= 2 * used + nap::Arena::minimumChunkSize);
+	CHECK(arena.getHugePageChunkCount() == 0);
+	CHECK(arena.getChunkCount() > 1);
+
+	// Next round: a single chunk of what the previous one used, rounded up to a page
+	arena.release();
+	CHECK(arena.getReservedSize() == 0);
+	for (auto i = 0; i < 200; ++i)
+		arena.allocate(1000 + 37 * i);
+	CHECK(arena.getChunkCount() == 1);
+	CHECK(arena.getReservedSize() < used + nap::Arena::pageSize);
+
+	// Large chunks are rounded to huge pages
+	arena.release();
+	arena.allocate(3 * 1024 * 1024);
+	CHECK(arena.getReservedSize() == 2 * nap::Arena::hugePageSize);
+
+	return 0;
+}
@@ -0,0 +1,71 @@
+#include "check.h"
+
+#include <audioworker.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+
+// Output is the input delayed by maxBlockSize samples. A block the worker can't finish in time
+// becomes silence without stalling the caller, and the delay stays the same afterwards.
+int main()
+{
+	constexpr int maxBlockSize = 64;
+	std::atomic<int> slowBlock = { -1 };
+	std::atomic<int> renderedBlocks = { 0 };
+	nap::AudioWorker worker([&](float** inputs, float** outputs, int numSamples)
+	{
+		if (renderedBlocks++ == slowBlock)
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		std::copy(inputs[0], inputs[0] + numSamples, outputs[0]);
+	});
+
+	nap::Arena arena;
+	worker.start(1, 1, maxBlockSize, arena);
+	CHECK(worker.getLatencySamples() == maxBlockSize);
+
+	std::vector<float> input;
+	std::vector<float> output;
+	const int blockSizes[] = { 64, 13, 1, 64, 40 };
+	int position = 0;
+	for (auto block = 0; block < 200; ++block)
+	{
+		const int numSamples = blockSizes[block % 5];
+		std::vector<float> in(numSamples);
+		std::vector<float> out(numSamples);
+		for (auto i = 0; i < numSamples; ++i)
+			in[i] = float(position + i + 1);
+		float* inputs[] = { in.data() };
+		float* outputs[] = { out.data() };
+
+		// Wait out the worker here, where the host would spend its time, so only the slow block is late
+		if (block == 100)
+			slowBlock = renderedBlocks.load();
+		auto start = std::chrono::steady_clock::now();
+		worker.process(inputs, outputs, numSamples);
+		CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(20));
+		if (block != 100)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		input.insert(input.end(), in.begin(), in.end());
+		output.insert(output.end(), out.begin(), out.end());
+		position += numSamples;
+	}
+	worker.stop();
+
+	CHECK(worker.getDropoutCount() > 0);
+	int silentSamples = 0;
+	for (auto i = 0; i < output.size(); ++i)
+	{
+		if (i < maxBlockSize)
+			CHECK(output[i] == 0.f);
+		else if (output[i] == 0.f)
+			silentSamples++;
+		else
+			CHECK(output[i] == input[i - maxBlockSize]);
+	}
+	CHECK(silentSamples > 0);
+	CHECK(silentSamples <= int(worker.getDropoutCount() + 1) * 2 * maxBlockSize);
+	return 0;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+
+// Reports the failed condition and ends the test with a non-zero exit code
+#define CHECK(condition)																				\
+	do																									\
+	{																									\
+		if (!(condition))																				\
+		{																								\
+			std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);		\
+			std::exit(1);																				\
+		}																								\
+	} while (false)
@@ -0,0 +1,40 @@
+#include "check.h"
+
+#include <cpugovernor.h>
+
+
+using Level = nap::CPUGovernor::ELevel;
+
+
+int main()
+{
+	nap::CPUGovernor governor;
+	CHECK(governor.getLevel() == Level::Full);
+
+	// Sustained overload sheds one level at a time, down to minimal
+	for (auto i = 0; i < 1000; ++i)
+		governor.addMeasurement(0.95, 1.0);
+	CHECK(governor.getLevel() == Level::Minimal);
+	CHECK(governor.getLevelChangeCount() == 3);
+
+	// Headroom brings quality back slowly
+	for (auto i = 0; i < 100; ++i)
+		governor.addMeasurement(0.1, 1.0);
+	CHECK(governor.getLevel() == Level::Minimal);
+	for (auto i = 0; i < 5000; ++i)
+		governor.addMeasurement(0.1, 1.0);
+	CHECK(governor.getLevel() == Level::Full);
+
+	CHECK(nap::CPUGovernor::getOversamplingLimit(Level::ReducedGUI, 4) == 4);
+	CHECK(nap::CPUGovernor::getOversamplingLimit(Level::ReducedOversampling, 4) == 2);
+	CHECK(nap::CPUGovernor::getOversamplingLimit(Level::ReducedOversampling, 1) == 1);
+	CHECK(nap::CPUGovernor::getOversamplingLimit(Level::Minimal, 8) == 1);
+	CHECK(nap::CPUGovernor::getVoiceLimit(Level::ReducedGUI, 10) == 10);
+	CHECK(nap::CPUGovernor::getVoiceLimit(Level::ReducedOversampling, 10) == 7);
+	CHECK(nap::CPUGovernor::getVoiceLimit(Level::Minimal, 10) == 5);
+	CHECK(nap::CPUGovernor::getVoiceLimit(Level::Minimal, 1) == 1);
+
+	governor.reset();
+	CHECK(governor.getLevel() == Level::Full);
+	return 0;
+}
@@ -0,0 +1,108 @@
+#include "check.h"
+
+#include <midirouter.h>
+
+#include <thread>
+#include <tuple>
+#include <vector>
+
+
+using EType = nap::MidiRouter::EType;
+using Event = std::tuple<EType, int, int, int>;
+
+
+static nap::MidiRouter::Filter makeFilter(bool listening)
+{
+	nap::MidiRouter::Filter filter;
+	filter.mTypes.fill(listening);
+	return filter;
+}
+
+
+static std::vector<Event> dispatchAll(nap::MidiRouter& router)
+{
+	std::vector<Event> events;
+	router.dispatch([&](EType type, int channel, int number, int value) { events.emplace_back(type, channel, number, value); });
+	return events;
+}
+
+
+int main()
+{
+	// Nothing listens before the first build
+	nap::MidiRouter router;
+	CHECK(!router.push(EType::NoteOn, 0, 60, 100));
+	CHECK(router.getFilteredCount() == 1);
+
+	// Type, channel and number filters, empty lists match everything
+	auto notes = makeFilter(false);
+	notes.mTypes[int(EType::NoteOn)] = true;
+	notes.mTypes[int(EType::NoteOff)] = true;
+	notes.mChannels = { 1 };
+	auto modWheel = makeFilter(false);
+	modWheel.mTypes[int(EType::ControlChange)] = true;
+	modWheel.mNumbers = { 1 };
+	router.build({ notes, modWheel });
+	CHECK(router.push(EType::NoteOn, 1, 60, 100));
+	CHECK(!router.push(EType::NoteOn, 0, 60, 100));
+	CHECK(router.push(EType::ControlChange, 5, 1, 64));
+	CHECK(!router.push(EType::ControlChange, 5, 7, 64));
+	CHECK(!router.push(EType::PitchBend, 1, 0, 64));
+	CHECK(router.push(EType::NoteOff, 1, 60, 0));
+
+	// Accepted events arrive in the order they were pushed
+	auto events = dispatchAll(router);
+	CHECK(events.size() == 3);
+	CHECK(events[0] == Event(EType::NoteOn, 1, 60, 100));
+	CHECK(events[1] == Event(EType::ControlChange, 5, 1, 64));
+	CHECK(events[2] == Event(EType::NoteOff, 1, 60, 0));
+	CHECK(dispatchAll(router).empty());
+
+	// Components bound to other ports never see host events, the default port is the empty name
+	auto otherPort = makeFilter(true);
+	otherPort.mPorts = { "Keyboard" };
+	router.build({ otherPort });
+	CHECK(!router.push(EType::NoteOn, 0, 60, 100));
+	otherPort.mPorts.emplace_back("");
+	router.build({ otherPort });
+	CHECK(router.push(EType::NoteOn, 0, 60, 100));
+	dispatchAll(router);
+
+	// A ring full of controllers still takes note ons and note offs, a ring full of note ons still takes note offs
+	router.build({ makeFilter(true) });
+	int controllerCount = 0;
+	while (router.push(EType::ControlChange, 0, 1, controllerCount & 0x7f))
+		controllerCount++;
+	CHECK(controllerCount == nap::MidiRouter::queueSize - nap::MidiRouter::noteReserve);
+	int noteOnCount = 0;
+	while (router.push(EType::NoteOn, 0, noteOnCount & 0x7f, 100))
+		noteOnCount++;
+	CHECK(noteOnCount == nap::MidiRouter::noteReserve / 2);
+	CHECK(!router.push(EType::PitchBend, 0, 0, 64));
+	int noteOffCount = 0;
+	while (router.push(EType::NoteOff, 0, noteOffCount & 0x7f, 0))
+		noteOffCount++;
+	CHECK(noteOffCount == nap::MidiRouter::noteReserve / 2);
+	CHECK(router.getDroppedCount() == 4);
+	events = dispatchAll(router);
+	CHECK(events.size() == nap::MidiRouter::queueSize);
+	CHECK(std::get<0>(events.back()) == EType::NoteOff);
+	CHECK(router.push(EType::ControlChange, 0, 1, 0));
+	dispatchAll(router);
+
+	// One producer and one consumer thread, nothing is lost or reordered while the ring has room
+	const int eventCount = 100000;
+	std::vector<Event> received;
+	std::thread producer([&]()
+	{
+		for (auto i = 0; i < eventCount; ++i)
+			while (!router.push(EType::NoteOff, i % 16, (i / 16) & 0x7f, (i / 2048) & 0x7f))
+				std::this_thread::yield();
+	});
+	while (received.size() < eventCount)
+		router.dispatch([&](EType type, int channel, int number, int value) { received.emplace_back(type, channel, number, value); });
+	producer.join();
+	for (auto i = 0; i < eventCount; ++i)
+		CHECK(received[i] == Event(EType::NoteOff, i % 16, (i / 16) & 0x7f, (i / 2048) & 0x7f));
+	return 0;
+}
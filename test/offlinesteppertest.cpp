@@ -0,0 +1,133 @@
+#include "check.h"
+
+#include <offlinestepper.h>
+#include <oversampler.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+
+struct NoteEvent
+{
+	int mPosition;		// Since the start of the render
+	float mFrequency;
+};
+
+
+// Stands in for the plugin: notes are queued by events and picked up by the next control step,
+// which also moves a gain ramp along by the audio time it is passed. The graph renders through a 2x oversampler.
+class Bounce
+{
+public:
+	Bounce(const std::vector<NoteEvent>& events) : mEvents(events)
+	{
+		mOversampler.prepare(1, 1, 512, 2, mArena);
+		mStepper.reset(128, 48000.0);
+	}
+
+	uint32_t render(const std::vector<int>& blockSizes, bool stall)
+	{
+		std::vector<float> output(512);
+		for (auto blockSize : blockSizes)
+		{
+			mOutput = output.data();
+			mBlockSize = blockSize;
+			mStepper.process(blockSize);
+			mBlockStart += blockSize;
+			float* channels[] = { output.data() };
+			mStepper.hash(channels, 1, blockSize);
+
+			// The wall clock has no say in the result
+			if (stall)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return mStepper.getHash();
+	}
+
+	int mStepCount = 0;
+	double mStepTime = 0.0;
+
+private:
+	void renderGraph(float** inputs, float** outputs, int numSamples)
+	{
+		for (auto i = 0; i < numSamples; ++i)
+		{
+			outputs[0][i] = mGain * std::sin(mPhase);
+			mPhase = std::fmod(mPhase + 2.0 * M_PI * mFrequency / 96000.0, 2.0 * M_PI);
+		}
+	}
+
+	std::vector<NoteEvent> mEvents;
+	int mEventIndex = 0;
+	int mBlockStart = 0;
+	int mBlockSize = 0;
+	float* mOutput = nullptr;
+	float mPendingFrequency = 0.f;
+	float mFrequency = 0.f;
+	float mGain = 0.f;
+	double mPhase = 0.0;
+
+	nap::Arena mArena;
+	nap::Oversampler mOversampler = { [this](float** inputs, float** outputs, int numSamples){ renderGraph(inputs, outputs, numSamples); } };
+	nap::OfflineStepper mStepper = { {
+		[this]()
+		{
+			return mEventIndex < mEvents.size() && mEvents[mEventIndex].mPosition < mBlockStart + mBlockSize ? mEvents[mEventIndex].mPosition - mBlockStart : -1;
+		},
+		[this]()
+		{
+			mPendingFrequency = mEvents[mEventIndex++].mFrequency;
+		},
+		[this](double deltaTime)
+		{
+			mStepCount++;
+			mStepTime += deltaTime;
+			if (mPendingFrequency > 0.f)
+			{
+				mFrequency = mPendingFrequency;
+				mPendingFrequency = 0.f;
+				mGain = 0.f;
+			}
+			mGain = std::min(1.0, mGain + deltaTime * 20.0);
+		},
+		[this](int offset, int numSamples)
+		{
+			float* outputs[] = { mOutput + offset };
+			mOversampler.process(nullptr, outputs, numSamples);
+		} } };
+};
+
+
+int main()
+{
+	const std::vector<NoteEvent> events = { { 0, 440.f }, { 300, 660.f }, { 301, 330.f }, { 1500, 880.f }, { 4000, 220.f } };
+	const std::vector<int> blocks(10, 512);
+	std::vector<int> unevenBlocks = { 1, 511, 17, 300, 195, 512, 64, 64, 128, 256, 512, 512, 512, 512, 512, 512 };
+
+	Bounce first(events);
+	auto firstHash = first.render(blocks, false);
+
+	// The same bounce again, with the host taking its time between blocks
+	Bounce second(events);
+	auto secondHash = second.render(blocks, true);
+	CHECK(firstHash == secondHash);
+
+	// Steps follow the audio clock, so they don't depend on how the host splits the render either
+	Bounce third(events);
+	auto thirdHash = third.render(unevenBlocks, false);
+	CHECK(firstHash == thirdHash);
+	CHECK(first.mStepCount == third.mStepCount);
+
+	// A step at most every 128 samples plus one per event, their time adds up to where the last one ran
+	CHECK(first.mStepCount >= 5120 / 128 && first.mStepCount <= 5120 / 128 + 1 + events.size());
+	CHECK(first.mStepTime > (5120 - 128) / 48000.0 && first.mStepTime <= 5120 / 48000.0);
+	CHECK(std::abs(first.mStepTime - third.mStepTime) < 1e-12);
+
+	// A different render gives a different hash
+	Bounce fourth({ { 0, 440.f }, { 301, 660.f } });
+	CHECK(fourth.render(blocks, false) != firstHash);
+	return 0;
+}
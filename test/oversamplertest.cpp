@@ -0,0 +1,74 @@
+#include "check.h"
+
+#include <oversampler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+// Runs an impulse through the oversampler around a pass-through render function, in blocks of varying size
+static std::vector<float> measureImpulseResponse(nap::Oversampler& oversampler, int length)
+{
+	std::vector<float> response;
+	const int blockSizes[] = { 64, 17, 1, 33 };
+	int position = 0;
+	for (auto block = 0; position < length; ++block)
+	{
+		const int numSamples = std::min(blockSizes[block % 4], length - position);
+		std::vector<float> input(numSamples, 0.f);
+		std::vector<float> output(numSamples, 0.f);
+		if (position == 0)
+			input[0] = 1.f;
+		float* inputs[] = { input.data() };
+		float* outputs[] = { output.data() };
+		oversampler.process(inputs, outputs, numSamples);
+		response.insert(response.end(), output.begin(), output.end());
+		position += numSamples;
+	}
+	return response;
+}
+
+
+// The response of the linear phase filters has to be symmetric around the reported latency, with unity gain at DC
+static void checkCenteredOn(const std::vector<float>& response, int latency)
+{
+	const auto peak = std::max_element(response.begin(), response.end()) - response.begin();
+	CHECK(peak == latency);
+
+	float sum = 0.f;
+	for (auto sample : response)
+		sum += sample;
+	CHECK(std::abs(sum - 1.f) < 1e-3f);
+
+	for (auto k = 1; k <= latency && latency + k < response.size(); ++k)
+		CHECK(std::abs(response[latency - k] - response[latency + k]) < 1e-5f);
+}
+
+
+int main()
+{
+	// Reported latencies are whole host samples, also at 4x and 8x where the group delay alone is not
+	CHECK(nap::Oversampler::getLatencySamples(1) == 0);
+	CHECK(nap::Oversampler::getLatencySamples(2) == 23);
+	CHECK(nap::Oversampler::getLatencySamples(4) == 29);
+	CHECK(nap::Oversampler::getLatencySamples(8) == 30);
+
+	auto passThrough = [](float** inputs, float** outputs, int numSamples)
+	{
+		std::copy(inputs[0], inputs[0] + numSamples, outputs[0]);
+	};
+
+	for (auto factor : { 1, 2, 4, 8 })
+	{
+		nap::Arena arena;
+		nap::Oversampler oversampler(passThrough);
+		oversampler.prepare(1, 1, 64, factor, arena);
+		CHECK(oversampler.getPreparedFactor() == factor);
+		checkCenteredOn(measureImpulseResponse(oversampler, 256), nap::Oversampler::getLatencySamples(factor));
+
+		oversampler.release();
+	}
+
+	return 0;
+}
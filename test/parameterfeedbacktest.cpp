@@ -0,0 +1,61 @@
+#include "check.h"
+
+#include <parameterfeedback.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+int main()
+{
+	nap::ParameterFeedback feedback;
+	feedback.init(3, 200);
+	CHECK(feedback.getCapacity() == 3);
+
+	// Changes between two reads arrive as one edit with the latest value
+	feedback.write(1, 0.25f);
+	feedback.write(1, 0.5f);
+	feedback.write(3, 1.f);
+	std::vector<std::pair<int, float>> edits;
+	feedback.read([&](int index, float value) { edits.emplace_back(index, value); });
+	CHECK(edits.size() == 1 && edits[0].first == 1 && edits[0].second == 0.5f);
+	edits.clear();
+	feedback.read([&](int index, float value) { edits.emplace_back(index, value); });
+	CHECK(edits.empty());
+
+	// Slots added later, across blocks, up to the maximum
+	feedback.grow(150);
+	CHECK(feedback.getCapacity() == 150);
+	feedback.grow(500);
+	CHECK(feedback.getCapacity() == 200);
+	feedback.write(130, 0.75f);
+	feedback.write(199, 0.1f);
+	feedback.write(200, 0.2f);
+	feedback.read([&](int index, float value) { edits.emplace_back(index, value); });
+	CHECK(edits.size() == 2 && edits[0].first == 130 && edits[1].first == 199);
+
+	// A reader on another thread sees every parameter's final value while the writer grows
+	nap::ParameterFeedback shared;
+	shared.init(1, 1000);
+	std::atomic<bool> done(false);
+	std::vector<float> seen(1000, -1.f);
+	std::thread reader([&]()
+	{
+		while (!done)
+			shared.read([&](int index, float value) { seen[index] = value; });
+		shared.read([&](int index, float value) { seen[index] = value; });
+	});
+	for (auto i = 0; i < 1000; ++i)
+	{
+		shared.grow(i + 1);
+		shared.write(i, 0.f);
+		shared.write(i, float(i) / 1000.f);
+	}
+	done = true;
+	reader.join();
+	for (auto i = 0; i < 1000; ++i)
+		CHECK(seen[i] == float(i) / 1000.f);
+
+	return 0;
+}
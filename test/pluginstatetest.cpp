@@ -0,0 +1,115 @@
+#include "check.h"
+
+#include <pluginstate.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+
+static void setInt(std::vector<char>& data, int offset, int32_t value)
+{
+	for (auto i = 0; i < 4; ++i)
+		data[offset + i] = char((uint32_t(value) >> (8 * i)) & 0xff);
+}
+
+
+int main()
+{
+	using EReadResult = nap::PluginState::EReadResult;
+
+	nap::PluginState state;
+	state.mBypass = true;
+	state.mRealtimeOversampling = 4;
+	state.mOfflineOversampling = 8;
+	state.mPresetIndex = 3;
+	state.mMorphTargetIndex = 5;
+	state.mMorphAmount = 0.75f;
+	state.mSchemaHash = 0xdeadbeef;
+	state.mValues = { 0.25f, 3.f, -1.5f, 2.f };
+	const std::vector<bool> integral = { false, true, false, true };
+
+	// Round trip, little endian regardless of the machine
+	auto data = state.write(integral);
+	CHECK(data.size() == 40 + 4 * state.mValues.size());
+	CHECK(data[0] == 0x4e && data[1] == 0x56 && data[2] == 0x53 && data[3] == 0x53);
+	nap::PluginState restored;
+	CHECK(restored.read(data.data(), data.size(), integral) == EReadResult::Full);
+	CHECK(restored.mBypass);
+	CHECK(restored.mRealtimeOversampling == 4);
+	CHECK(restored.mOfflineOversampling == 8);
+	CHECK(restored.mPresetIndex == 3);
+	CHECK(restored.mMorphTargetIndex == 5);
+	CHECK(restored.mMorphAmount == 0.75f);
+	CHECK(restored.mSchemaHash == 0xdeadbeef);
+	CHECK(restored.mValues == state.mValues);
+
+	// Integral values are stored as int32
+	int32_t storedInt;
+	std::memcpy(&storedInt, data.data() + 40 + 4, 4);
+	CHECK(storedInt == 3);
+
+	// Chunks from before the header only hold the bypass flag
+	std::vector<char> legacy(4, 0);
+	setInt(legacy, 0, 1);
+	nap::PluginState legacyState;
+	CHECK(legacyState.read(legacy.data(), legacy.size(), integral) == EReadResult::BypassOnly);
+	CHECK(legacyState.mBypass);
+
+	// Version 1 chunks have no preset selection
+	std::vector<char> version1(data.begin(), data.begin() + 20);
+	version1.insert(version1.end(), data.begin() + 32, data.end());
+	setInt(version1, 4, 1);
+	nap::PluginState version1State;
+	CHECK(version1State.read(version1.data(), version1.size(), integral) == EReadResult::Full);
+	CHECK(version1State.mPresetIndex == 0 && version1State.mMorphAmount == 0.f);
+	CHECK(version1State.mValues == state.mValues && version1State.mSchemaHash == 0xdeadbeef);
+
+	// Anything out of range is rejected without touching the state
+	for (auto oversampling : { 0, 3, 16, -2 })
+	{
+		for (auto offset : { 12, 16 })
+		{
+			auto corrupt = data;
+			setInt(corrupt, offset, oversampling);
+			nap::PluginState rejected;
+			CHECK(rejected.read(corrupt.data(), corrupt.size(), integral) == EReadResult::Invalid);
+			CHECK(rejected.mValues.empty() && rejected.mRealtimeOversampling == 1);
+		}
+	}
+	auto negativePreset = data;
+	setInt(negativePreset, 20, -1);
+	CHECK(restored.read(negativePreset.data(), negativePreset.size(), integral) == EReadResult::Invalid);
+	auto newer = data;
+	setInt(newer, 4, nap::PluginState::version + 1);
+	CHECK(restored.read(newer.data(), newer.size(), integral) == EReadResult::Invalid);
+	auto oversized = data;
+	setInt(oversized, 36, 1 << 30);
+	CHECK(restored.read(oversized.data(), oversized.size(), integral) == EReadResult::Invalid);
+	for (auto size = 0; size < data.size(); ++size)
+		CHECK(restored.read(data.data(), size, integral) == EReadResult::Invalid);
+
+	// Save and restore time for a large parameter set, reported rather than checked
+	constexpr int parameterCount = 2000;
+	constexpr int iterationCount = 1000;
+	nap::PluginState large;
+	std::vector<bool> largeIntegral(parameterCount);
+	for (auto i = 0; i < parameterCount; ++i)
+	{
+		large.mValues.emplace_back(i % 3 == 0 ? float(i % 7) : i * 0.001f);
+		largeIntegral[i] = i % 3 == 0;
+	}
+	auto start = std::chrono::steady_clock::now();
+	size_t totalSize = 0;
+	for (auto i = 0; i < iterationCount; ++i)
+	{
+		auto chunk = large.write(largeIntegral);
+		nap::PluginState read;
+		CHECK(read.read(chunk.data(), chunk.size(), largeIntegral) == EReadResult::Full);
+		totalSize += chunk.size();
+	}
+	std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+	std::printf("%d parameters, %zu byte chunk: %.1f us per save and restore\n", parameterCount, totalSize / iterationCount, elapsed.count() / iterationCount);
+
+	return 0;
+}
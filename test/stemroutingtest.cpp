@@ -0,0 +1,39 @@
+#include "check.h"
+
+#include <fstream>
+#include <regex>
+#include <sstream>
+#include <string>
+
+
+// The app structure has to put audio on the stem bus, channels 2 and 3 with the default stereo layout.
+// Rendering the graph needs NAP, this checks the routing the OutputComponent is configured with.
+int main()
+{
+	std::ifstream file(NAPVST_DATA_DIR "/objects.json");
+	CHECK(file.good());
+	std::stringstream stream;
+	stream << file.rdbuf();
+	const std::string json = stream.str();
+
+	// The graph's output object, its channels are what the routing can pick from
+	std::smatch graphOutput;
+	CHECK(std::regex_search(json, graphOutput, std::regex("\"Output\"\\s*:\\s*\"([^\"]+)\"")));
+	std::smatch outputObject;
+	CHECK(std::regex_search(json, outputObject, std::regex("\"mID\"\\s*:\\s*\"" + graphOutput[1].str() + "\"[^}]*\"ChannelCount\"\\s*:\\s*(\\d+)")));
+	const int graphChannelCount = std::stoi(outputObject[1].str());
+
+	std::smatch routing;
+	CHECK(std::regex_search(json, routing, std::regex("\"nap::audio::OutputComponent\"[^}]*\"Routing\"\\s*:\\s*\\[([^\\]]*)\\]")));
+	const std::string channels = routing[1].str();
+	const std::regex number("-?\\d+");
+	int routedCount = 0;
+	for (auto it = std::sregex_iterator(channels.begin(), channels.end(), number); it != std::sregex_iterator(); ++it)
+	{
+		int source = std::stoi(it->str());
+		CHECK(source >= 0 && source < graphChannelCount);
+		routedCount++;
+	}
+	CHECK(routedCount >= 4);
+	return 0;
+}
@@ -0,0 +1,64 @@
+#include "check.h"
+
+#include <telemetry.h>
+
+#include <cstdlib>
+#include <filesystem>
+
+
+int main()
+{
+	// Counters and overruns, a tick only overruns when it takes longer than the configured period
+	nap::Telemetry telemetry;
+	telemetry.open();
+	CHECK(telemetry.isOpen());
+	auto& layout = telemetry.getLayout();
+	CHECK(layout.mMagic == nap::Telemetry::magic);
+
+	telemetry.recordBlock(0.0005, 0.001);
+	telemetry.recordBlock(0.002, 0.001);
+	CHECK(layout.mBlockCount.load() == 2);
+	CHECK(layout.mDeadlineMissCount.load() == 1);
+	CHECK(telemetry.getBlockTimePercentile(0.5f) < 1.f);
+
+	telemetry.recordControlTick(0.010, 1.0 / 60.0);
+	telemetry.recordControlTick(0.020, 1.0 / 60.0);
+	CHECK(layout.mControlTickCount.load() == 2);
+	CHECK(layout.mControlOverrunCount.load() == 1);
+
+	// The file is private to the user and goes away with the instance
+	const auto path = telemetry.getPath();
+	if (!path.empty())
+	{
+		auto permissions = std::filesystem::symlink_status(path).permissions();
+		CHECK(std::filesystem::is_regular_file(std::filesystem::symlink_status(path)));
+		CHECK((permissions & (std::filesystem::perms::group_all | std::filesystem::perms::others_all)) == std::filesystem::perms::none);
+	}
+	telemetry.close();
+	CHECK(!telemetry.isOpen());
+	if (!path.empty())
+		CHECK(!std::filesystem::exists(path));
+
+	// Every instance gets a file of its own
+	nap::Telemetry other;
+	telemetry.open();
+	other.open();
+	if (!telemetry.getPath().empty())
+		CHECK(telemetry.getPath() != other.getPath());
+	other.close();
+	telemetry.close();
+
+	// Unless it was asked for
+	setenv("NAPVST_KEEP_TELEMETRY", "1", 1);
+	telemetry.open();
+	const auto keptPath = telemetry.getPath();
+	telemetry.close();
+	if (!keptPath.empty())
+	{
+		CHECK(std::filesystem::exists(keptPath));
+		std::filesystem::remove(keptPath);
+	}
+	unsetenv("NAPVST_KEEP_TELEMETRY");
+
+	return 0;
+}
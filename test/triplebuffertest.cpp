@@ -0,0 +1,66 @@
+#include "check.h"
+
+#include <triplebuffer.h>
+
+#include <array>
+#include <atomic>
+#include <thread>
+
+
+int main()
+{
+	nap::TripleBuffer<int> buffer;
+	buffer.init(7);
+	CHECK(!buffer.update());
+	CHECK(buffer.getReadBuffer() == 7);
+
+	// The reader only sees the latest publication
+	buffer.getWriteBuffer() = 1;
+	buffer.publish();
+	buffer.getWriteBuffer() = 2;
+	buffer.publish();
+	CHECK(buffer.update());
+	CHECK(buffer.getReadBuffer() == 2);
+	CHECK(!buffer.update());
+	CHECK(buffer.getReadBuffer() == 2);
+
+	// Writing without publishing leaves the reader alone
+	buffer.getWriteBuffer() = 3;
+	CHECK(!buffer.update());
+	CHECK(buffer.getReadBuffer() == 2);
+	buffer.publish();
+	CHECK(buffer.update());
+	CHECK(buffer.getReadBuffer() == 3);
+
+	// Across threads every version the reader sees is complete and versions never go back
+	using Version = std::array<int, 64>;
+	nap::TripleBuffer<Version> shared;
+	Version initial;
+	initial.fill(0);
+	shared.init(initial);
+	const int versionCount = 100000;
+	std::atomic<bool> torn = { false };
+	std::thread reader([&]()
+	{
+		int last = 0;
+		while (last < versionCount)
+		{
+			shared.update();
+			auto& version = shared.getReadBuffer();
+			for (auto value : version)
+				if (value != version[0])
+					torn = true;
+			if (version[0] < last)
+				torn = true;
+			last = version[0];
+		}
+	});
+	for (auto i = 1; i <= versionCount; ++i)
+	{
+		shared.getWriteBuffer().fill(i);
+		shared.publish();
+	}
+	reader.join();
+	CHECK(!torn);
+	return 0;
+}
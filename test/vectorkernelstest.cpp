@@ -0,0 +1,60 @@
+#include "check.h"
+
+#include <vectorkernels.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+
+// Compares the dispatched kernels against plain scalar loops, on odd sizes and unaligned pointers
+int main()
+{
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+
+	for (auto count : { 0, 1, 7, 8, 33, 64, 1021 })
+	{
+		for (auto offset : { 0, 1, 3 })
+		{
+			std::vector<float> source(count + offset);
+			std::vector<float> accumulator(count + offset);
+			for (auto& sample : source)
+				sample = distribution(random);
+			for (auto& sample : accumulator)
+				sample = distribution(random);
+
+			// Accumulation and multiplication are element wise, the results have to match exactly
+			auto expected = accumulator;
+			for (auto i = 0; i < count; ++i)
+				expected[offset + i] += 0.25f * source[offset + i];
+			nap::simd::multiplyAccumulate(accumulator.data() + offset, source.data() + offset, 0.25f, count);
+			for (auto i = 0; i < count; ++i)
+				CHECK(std::abs(accumulator[offset + i] - expected[offset + i]) <= 1e-6f);
+
+			expected = accumulator;
+			for (auto i = 0; i < count; ++i)
+				expected[offset + i] *= source[offset + i];
+			nap::simd::multiply(accumulator.data() + offset, source.data() + offset, count);
+			for (auto i = 0; i < count; ++i)
+				CHECK(accumulator[offset + i] == expected[offset + i]);
+
+			// The sum of squares is added up in a different order
+			float expectedPeak = 0.5f;
+			double expectedSum = 0.0;
+			for (auto i = 0; i < count; ++i)
+			{
+				expectedPeak = std::max(expectedPeak, std::abs(source[offset + i]));
+				expectedSum += source[offset + i] * source[offset + i];
+			}
+			float peak = 0.5f;
+			float sumOfSquares = 0.f;
+			nap::simd::measureLevels(source.data() + offset, count, peak, sumOfSquares);
+			CHECK(peak == expectedPeak);
+			CHECK(std::abs(sumOfSquares - expectedSum) <= 1e-4 * (1.0 + expectedSum));
+		}
+	}
+
+	return 0;
+}
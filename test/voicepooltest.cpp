@@ -0,0 +1,143 @@
+#include "check.h"
+
+#include <voicepool.h>
+
+
+using Policy = nap::VoicePool::EPolicy;
+
+
+// Off leaves stealing to the synth: every note is passed on and nothing is released for it
+static void testOff()
+{
+	nap::VoicePool pool;
+	pool.setCapacity(2);
+	for (auto pitch = 60; pitch < 64; ++pitch)
+		CHECK(!pool.noteOn(0, pitch, -1, 1.f).isValid());
+	CHECK(pool.getStolenCount() == 0);
+	for (auto pitch = 60; pitch < 64; ++pitch)
+		CHECK(pool.noteOff(0, pitch, -1));
+}
+
+
+// Released voices stay busy for the release length and are given up before a held voice is stolen
+static void testReleaseTails()
+{
+	nap::VoicePool pool;
+	pool.setPolicy(Policy::Oldest);
+	pool.setCapacity(2);
+	pool.setReleaseLength(1000);
+
+	pool.noteOn(0, 60, -1, 1.f);
+	pool.noteOn(0, 62, -1, 1.f);
+	CHECK(pool.noteOff(0, 60, -1));
+	CHECK(pool.getHeldCount() == 1 && pool.getReleasingCount() == 1);
+	pool.advance(999);
+	CHECK(pool.getReleasingCount() == 1);
+	pool.advance(1);
+	CHECK(pool.getReleasingCount() == 0);
+
+	// Full with a tail: the tail goes, the held note keeps playing
+	CHECK(pool.noteOff(0, 62, -1));
+	pool.noteOn(0, 64, -1, 1.f);
+	CHECK(!pool.noteOn(0, 65, -1, 1.f).isValid());
+	CHECK(pool.getStolenCount() == 0);
+	CHECK(pool.getHeldCount() == 2 && pool.getReleasingCount() == 0);
+
+	// Full without tails: the oldest held note is released
+	auto released = pool.noteOn(0, 67, -1, 1.f);
+	CHECK(released.isValid() && released.mChannel == 0 && released.mPitch == 64);
+	CHECK(pool.getStolenCount() == 1);
+	CHECK(pool.getHeldCount() == 2);
+
+	// Its note off comes later and is not passed on again
+	CHECK(pool.noteOff(0, 64, -1));
+	CHECK(pool.getHeldCount() == 2);
+}
+
+
+static void testQuietest()
+{
+	nap::VoicePool pool;
+	pool.setPolicy(Policy::Quietest);
+	pool.setCapacity(3);
+	pool.noteOn(0, 60, -1, 0.9f);
+	pool.noteOn(0, 61, -1, 0.2f);
+	pool.noteOn(0, 62, -1, 0.5f);
+	auto released = pool.noteOn(0, 63, -1, 1.f);
+	CHECK(released.mPitch == 61);
+	released = pool.noteOn(0, 64, -1, 1.f);
+	CHECK(released.mPitch == 62);
+}
+
+
+// Two voices of one note: only the last note off reaches the synth, by note id
+static void testSharedNote()
+{
+	nap::VoicePool pool;
+	pool.setCapacity(4);
+	pool.noteOn(0, 60, 7, 1.f);
+	pool.noteOn(0, 60, 8, 1.f);
+	pool.noteOn(1, 60, 9, 1.f);
+	CHECK(!pool.noteOff(0, 60, 8));
+	CHECK(pool.getHeldCount() == 3);
+	CHECK(pool.noteOff(0, 60, 7));
+	CHECK(pool.getHeldCount() == 1 && pool.getReleasingCount() == 2);
+	CHECK(pool.noteOff(1, 60, 9));
+}
+
+
+static void testRetrigger()
+{
+	nap::VoicePool pool;
+	pool.setPolicy(Policy::RetriggerOldest);
+	pool.setCapacity(4);
+	pool.setReleaseLength(100);
+	pool.noteOn(0, 60, -1, 1.f);
+	auto released = pool.noteOn(0, 60, -1, 1.f);
+	CHECK(released.mChannel == 0 && released.mPitch == 60);
+	CHECK(pool.getHeldCount() == 1 && pool.getReleasingCount() == 1);
+	CHECK(pool.getStolenCount() == 0);
+	CHECK(pool.noteOff(0, 60, -1));
+}
+
+
+// A lower limit steals quietest even without a policy, one note at a time
+static void testLimit()
+{
+	nap::VoicePool pool;
+	pool.setCapacity(8);
+	for (auto pitch = 60; pitch < 66; ++pitch)
+		pool.noteOn(0, pitch, -1, 0.1f * (pitch - 59));
+	pool.setLimit(2);
+	CHECK(pool.getCapacity() == 2);
+	auto released = pool.noteOn(0, 70, -1, 1.f);
+	CHECK(released.mPitch == 60);
+	CHECK(pool.getHeldCount() == 5);
+	pool.setLimit(nap::VoicePool::maxCapacity);
+	CHECK(!pool.noteOn(0, 71, -1, 1.f).isValid());
+	CHECK(pool.getCapacity() == 8);
+}
+
+
+static void testReset()
+{
+	nap::VoicePool pool;
+	pool.noteOn(0, 60, -1, 1.f);
+	pool.requestReset();
+	pool.advance(1);
+	CHECK(pool.getHeldCount() == 0);
+	CHECK(pool.noteOff(0, 60, -1));
+}
+
+
+int main()
+{
+	testOff();
+	testReleaseTails();
+	testQuietest();
+	testSharedNote();
+	testRetrigger();
+	testLimit();
+	testReset();
+	return 0;
+}